@@ -0,0 +1,96 @@
+// Standalone benchmark: g++ -std=c++17 -O2 -pthread -I.. parse_block_parallel_benchmark.cpp ../text_utils.cpp
+// Usage: ./a.out [megabytes of input, default 64] [max threads, default hardware_concurrency]
+
+#include "text_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using text_utils::Node;
+
+namespace {
+
+/// A block of records shaped like a typical configuration dump, about @p bytes long.
+std::string make_document(size_t bytes) {
+    std::string doc = "{";
+    for (size_t i = 0; doc.size() < bytes; ++i) {
+        if (i)
+            doc += ", ";
+        doc += "record_" + std::to_string(i) + "={id = " + std::to_string(i) +
+               ", name = item number " + std::to_string(i % 977) +
+               ", position=(x = 1.5, y = -2.25, z = 0), tags=(alpha, beta, gamma), enabled = true}";
+    }
+    doc += "}";
+    return doc;
+}
+
+bool same_tree(const Node &a, const Node &b) {
+    if (a.key != b.key || a.value != b.value || a.is_block != b.is_block || a.block_type != b.block_type ||
+        a.children.size() != b.children.size())
+        return false;
+    for (size_t i = 0; i < a.children.size(); ++i)
+        if (!same_tree(a.children[i], b.children[i]))
+            return false;
+    return true;
+}
+
+/// Best wall time of a few runs of @p parse, in seconds.
+template <typename Parse> double best_time(Parse &&parse) {
+    double best = 1e30;
+    for (int run = 0; run < 3; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        parse();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    size_t max_threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    max_threads = std::max<size_t>(max_threads, 1);
+
+    std::string doc = make_document(megabytes << 20);
+    size_t pos = 0;
+    Node expected = text_utils::parse_block(doc, pos);
+
+    double sequential = best_time([&] {
+        size_t p = 0;
+        Node root = text_utils::parse_block(doc, p);
+    });
+
+    std::cout << std::fixed << std::setprecision(1) << "input " << doc.size() / 1e6 << " MB, "
+              << expected.children.size() << " top-level children\n"
+              << "parse_block            " << std::setw(8) << sequential * 1e3 << " ms\n";
+
+    // Powers of two up to max_threads, always finishing with max_threads itself.
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    if (thread_counts.back() != max_threads)
+        thread_counts.push_back(max_threads);
+
+    for (size_t threads : thread_counts) {
+        Node root;
+        double parallel = best_time([&] {
+            size_t p = 0;
+            root = text_utils::parse_block_parallel(doc, p, threads);
+        });
+        if (!same_tree(root, expected)) {
+            std::cerr << "parse_block_parallel with " << threads << " threads differs from parse_block\n";
+            return 1;
+        }
+        std::cout << "parse_block_parallel " << std::setw(2) << threads << " " << std::setw(8) << parallel * 1e3
+                  << " ms  speedup " << std::setprecision(2) << sequential / parallel << std::setprecision(1) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Standalone test: g++ -std=c++17 -I.. allocation_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+namespace {
+
+size_t allocations = 0;
+
+/// Number of heap allocations made while running @p f.
+template <typename F> size_t count_allocations(F &&f) {
+    size_t before = allocations;
+    f();
+    return allocations - before;
+}
+
+/// The read-only queries take and return views, so none of them may touch the heap.
+void test_queries_do_not_allocate() {
+    using namespace text_utils;
+    const std::string text = "  some longer text that does not fit in the small string buffer  ";
+    bool b = false;
+    size_t n = 0;
+
+    assert(count_allocations([&] { b = starts_with(text, "  some longer"); }) == 0 && b);
+    assert(count_allocations([&] { b = contains(text, "small string"); }) == 0 && b);
+    assert(count_allocations([&] { n = trim_view(text).size(); }) == 0 && n == text.size() - 4);
+    assert(count_allocations([&] { n = get_substring_view(text, 2, 6).size(); }) == 0 && n == 4);
+    assert(count_allocations([&] { b = is_integer("  -123456"); }) == 0 && b);
+    assert(count_allocations([&] { b = is_rational("-12.5"); }) == 0 && b);
+    assert(count_allocations([&] { n = escaped_size(text); }) == 0 && n == text.size());
+    assert(count_allocations([&] { b = split_once_from_right_view(text, " ").second.has_value(); }) == 0 && b);
+
+    Tokenizer tokenizer(" ", "");
+    assert(count_allocations([&] {
+               size_t pos = 0;
+               while (pos < text.size())
+                   n = tokenizer.next(text, pos).text.size();
+           }) == 0);
+
+    LineIndex lines("first line\nsecond line\nthird line");
+    assert(count_allocations([&] { n = lines.line(1).size(); }) == 0 && n == 11);
+}
+
+/// Lookups must not build a std::string from the path (a '/' separated path is the only exception).
+void test_node_path_index_find_does_not_allocate() {
+    using namespace text_utils;
+    size_t pos = 0;
+    Node root = parse_block("{a_rather_long_key_name={another_rather_long_key = 1}}", pos);
+    NodePathIndex index(root);
+    const Node *found = nullptr;
+
+    assert(count_allocations([&] { found = index.find("a_rather_long_key_name.another_rather_long_key"); }) == 0);
+    assert(found && found->value == "1");
+    assert(count_allocations([&] { found = index.find("a_rather_long_key_name.missing"); }) == 0 && !found);
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+int main() {
+    test_queries_do_not_allocate();
+    test_node_path_index_find_does_not_allocate();
+    std::cout << "allocation_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Standalone test: g++ -std=c++17 -I.. box_render_cache_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using text_utils::BoxOptions;
+using text_utils::BoxRenderCache;
+
+namespace {
+
+/// Render @p doc and check the cache's counters for that render alone.
+void check_render(BoxRenderCache &cache, std::string_view doc, size_t hits, size_t misses) {
+    cache.reset_stats();
+    std::string out = cache.render(doc);
+    assert(out == text_utils::format_nested_braces_string_recursive_as_boxes(doc, cache.options()));
+    assert(cache.hits() == hits);
+    assert(cache.misses() == misses);
+}
+
+/// Cached or not, the output is that of the one-shot renderer with the same options.
+void test_output_matches_uncached_render() {
+    const char *docs[] = {
+        "{}",
+        "{a=1, b=2}",
+        "{name=a_rather_long_name, inner={x=1, y=2, deeper={z=3}}, c=3, d=4}",
+        "{list=(1, 2, (3, 4)), {x=1}, {x=1}, same={x=1}, other={x=1}}",
+    };
+    std::vector<BoxOptions> option_sets(3);
+    option_sets[1].max_depth = 1;
+    option_sets[1].max_children = 2;
+    option_sets[2].min_inner = 2;
+    option_sets[2].h_pad = 1;
+    option_sets[2].v_pad = 0;
+    option_sets[2].max_text_width = 6;
+
+    for (const auto &options : option_sets) {
+        BoxRenderCache cache(1024, options);
+        for (int pass = 0; pass < 2; ++pass)
+            for (const char *doc : docs)
+                assert(cache.render(std::string_view(doc)) ==
+                       text_utils::format_nested_braces_string_recursive_as_boxes(doc, options));
+    }
+}
+
+/// After one leaf changes, only the blocks on its path are laid out again.
+void test_one_changed_leaf() {
+    BoxRenderCache cache;
+    check_render(cache, "{a={x=1}, b={y=2}, c={z=3}}", 0, 4);
+    assert(cache.size() == 4);
+
+    // the root and a changed; b and c come from the cache
+    check_render(cache, "{a={x=9}, b={y=2}, c={z=3}}", 2, 2);
+    assert(cache.size() == 6);
+
+    // an unchanged tree is a single hit on its root, whose children are not looked at
+    check_render(cache, "{a={x=9}, b={y=2}, c={z=3}}", 1, 0);
+
+    cache.clear();
+    assert(cache.size() == 0);
+    check_render(cache, "{a={x=9}, b={y=2}, c={z=3}}", 0, 4);
+}
+
+/// With a small capacity the least recently used boxes are dropped, and a hit counts as a use.
+void test_lru_eviction() {
+    BoxRenderCache cache(2);
+    check_render(cache, "{a={x=1}}", 0, 2); // cached: root, a
+    check_render(cache, "{b={y=2}}", 0, 2); // b evicts a, its root evicts the first root
+    assert(cache.size() == 2);
+    check_render(cache, "{b={y=2}}", 1, 0);
+    check_render(cache, "{a={x=1}}", 0, 2); // both of its boxes were evicted
+
+    // a was cached before the root of "{a={x=1}}", but its hit here makes that root the one evicted
+    check_render(cache, "{a={x=1}, b=2}", 1, 1);
+    check_render(cache, "{a={x=1}}", 1, 1);
+    assert(cache.size() == 2);
+}
+
+/// A capacity of 0 keeps nothing, so every render lays out every block.
+void test_zero_capacity() {
+    BoxRenderCache cache(0);
+    assert(cache.capacity() == 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        check_render(cache, "{a={x=1}, b={y=2}}", 0, 3);
+        assert(cache.size() == 0);
+    }
+}
+
+} // namespace
+
+int main() {
+    test_output_matches_uncached_render();
+    test_one_changed_leaf();
+    test_lru_eviction();
+    test_zero_capacity();
+    std::cout << "box_render_cache_test: ok\n";
+    return 0;
+}
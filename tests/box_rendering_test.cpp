@@ -0,0 +1,158 @@
+// Standalone test: g++ -std=c++17 -I.. box_rendering_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using text_utils::BoxLineGenerator;
+using text_utils::BoxOptions;
+using text_utils::BoxViewport;
+using text_utils::Node;
+
+namespace {
+
+/// A random nested braces document with keyed and positional leaves and blocks of both bracket types.
+std::string random_document(std::mt19937 &rng, size_t depth = 0) {
+    auto pick = [&](size_t n) { return static_cast<size_t>(rng() % n); };
+    bool paren = depth > 0 && pick(4) == 0;
+    std::string doc(1, paren ? '(' : '{');
+    size_t children = pick(depth < 3 ? 5 : 3);
+    for (size_t i = 0; i < children; ++i) {
+        if (i)
+            doc += ", ";
+        if (pick(3) != 0)
+            doc += std::string(1 + pick(12), static_cast<char>('a' + pick(26))) + " = ";
+        if (depth < 3 && pick(3) == 0)
+            doc += random_document(rng, depth + 1);
+        else
+            doc += std::to_string(rng() % 100000);
+    }
+    doc += paren ? ')' : '}';
+    return doc;
+}
+
+Node parse(const std::string &doc) {
+    size_t pos = 0;
+    return text_utils::parse_block(doc, pos);
+}
+
+std::vector<std::string> rows_of(BoxLineGenerator &rows) {
+    std::vector<std::string> out;
+    for (std::string row; rows.next(row);)
+        out.push_back(row);
+    return out;
+}
+
+std::string joined(const std::vector<std::string> &rows) {
+    std::string out;
+    for (const auto &row : rows)
+        out += row + "\n";
+    return out;
+}
+
+/// The rows and columns of @p full that @p viewport covers.
+std::vector<std::string> crop(const std::vector<std::string> &full, const BoxViewport &viewport) {
+    std::vector<std::string> out;
+    for (size_t r = viewport.row; r < full.size() && r - viewport.row < viewport.height; ++r)
+        out.push_back(full[r].substr(std::min(viewport.column, full[r].size()), viewport.width));
+    return out;
+}
+
+/// A viewport that is sometimes unbounded, and sometimes starts or reaches past the edges of the rendering.
+BoxViewport random_viewport(std::mt19937 &rng, size_t width, size_t height) {
+    auto coordinate = [&](size_t extent) { return static_cast<size_t>(rng() % (extent + 3)); };
+    BoxViewport viewport;
+    viewport.row = coordinate(height);
+    viewport.column = coordinate(width);
+    viewport.height = rng() % 4 == 0 ? std::string::npos : coordinate(height);
+    viewport.width = rng() % 4 == 0 ? std::string::npos : coordinate(width);
+    return viewport;
+}
+
+/// BoxLineGenerator produces the rows of the one-shot rendering, and a viewport crops them exactly.
+void test_viewport_matches_full_render() {
+    std::mt19937 rng(39);
+    std::vector<BoxOptions> option_sets(4);
+    option_sets[1].min_inner = 2;
+    option_sets[1].h_pad = 0;
+    option_sets[1].v_pad = 0;
+    option_sets[2].max_depth = 1;
+    option_sets[2].max_children = 2;
+    option_sets[3].max_text_width = 5;
+    option_sets[3].v_pad = 2;
+
+    for (int tree = 0; tree < 2000; ++tree) {
+        std::string doc = random_document(rng);
+        const BoxOptions &options = option_sets[static_cast<size_t>(tree) % option_sets.size()];
+
+        BoxLineGenerator rows(parse(doc), options);
+        std::vector<std::string> full = rows_of(rows);
+        assert(joined(full) == text_utils::format_nested_braces_string_recursive_as_boxes(doc, options));
+        assert(full.size() == rows.height());
+        for (const auto &row : full)
+            assert(row.size() == rows.width());
+
+        // the same generator is scrolled around without being rebuilt
+        for (int view = 0; view < 5; ++view) {
+            BoxViewport viewport = random_viewport(rng, rows.width(), rows.height());
+            rows.set_viewport(viewport);
+            assert(rows_of(rows) == crop(full, viewport));
+        }
+    }
+}
+
+/// Folded blocks, folded children and shortened text.
+void test_elision() {
+    std::string doc = "{name=a_rather_long_name, inner={x=1, y=2, deeper={z=3}}, c=3, d=4}";
+    BoxOptions options;
+    options.min_inner = 4;
+    options.h_pad = 1;
+    options.v_pad = 0;
+    options.max_depth = 1;
+    options.max_children = 3;
+    options.max_text_width = 12;
+
+    assert(text_utils::format_nested_braces_string_recursive_as_boxes(doc, options) ==
+           "====================\n"
+           "| name = a_...     |\n"
+           "| ==== inner ===== |\n"
+           "| | x = 1        | |\n"
+           "| | y = 2        | |\n"
+           "| | deeper {...} | |\n"
+           "| ================ |\n"
+           "| c = 3            |\n"
+           "| ... (1 more)     |\n"
+           "====================\n");
+}
+
+/// A width too small for "..." shortens to dots only, titles included.
+void test_max_text_width_below_marker() {
+    BoxOptions options;
+    options.max_text_width = 2;
+
+    assert(text_utils::format_nested_braces_string_recursive_as_boxes("{longkey={v=1}}", options) ==
+           "========================\n"
+           "|                      |\n"
+           "|   ====== .. ======   |\n"
+           "|   |              |   |\n"
+           "|   |   ..         |   |\n"
+           "|   |              |   |\n"
+           "|   ================   |\n"
+           "|                      |\n"
+           "========================\n");
+}
+
+} // namespace
+
+int main() {
+    test_viewport_matches_full_render();
+    test_elision();
+    test_max_text_width_below_marker();
+    std::cout << "box_rendering_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Standalone test: g++ -std=c++17 -pthread -I.. concurrent_string_accumulator_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using text_utils::ConcurrentStringAccumulator;
+
+namespace {
+
+std::string concat(const std::vector<std::string> &pieces) { return text_utils::join(pieces, ""); }
+
+/// Partially filled segments only reach drain_segments() once their producer flushes them.
+void test_flush_hands_off_partial_segment() {
+    ConcurrentStringAccumulator acc(ConcurrentStringAccumulator::Order::per_thread, 1024);
+    acc.add("abc");
+    assert(acc.drain_segments().empty());
+
+    acc.flush();
+    assert(concat(acc.drain_segments()) == "abc");
+    acc.flush(); // nothing pending
+    assert(acc.drain_segments().empty());
+}
+
+/// Drained fragments of several threads come out in add() order with Order::sequence.
+void test_drain_segments_keeps_sequence_order() {
+    ConcurrentStringAccumulator acc(ConcurrentStringAccumulator::Order::sequence, 1024);
+    auto add_then_flush = [&](const char *text) {
+        std::thread([&, text] {
+            acc.add(text);
+            acc.flush();
+        }).join();
+    };
+    add_then_flush("1");
+    acc.add("2");
+    acc.flush();
+    add_then_flush("3");
+
+    assert(concat(acc.drain_segments()) == "123");
+    assert(acc.str().empty());
+}
+
+/// A thread may outlive its accumulators and an accumulator may outlive its threads.
+void test_thread_and_accumulator_lifetimes() {
+    for (int round = 0; round < 100; ++round) {
+        ConcurrentStringAccumulator short_lived;
+        short_lived.add("x");
+        assert(short_lived.str() == "x");
+    }
+
+    ConcurrentStringAccumulator acc;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t)
+        producers.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i)
+                acc.add('a');
+        });
+    for (auto &producer : producers)
+        producer.join();
+    assert(acc.size() == 4000);
+
+    acc.add("b");
+    assert(acc.size() == 4001);
+}
+
+/// A writer drains segments while producers append; every fragment comes out once, each thread's in its add() order.
+void test_drain_segments_while_producing(ConcurrentStringAccumulator::Order order) {
+    const int producer_count = 4;
+    const int fragments_per_producer = 5000;
+    const int extra_fragments = 3; // added after flush(), so they are only seen by str()
+    ConcurrentStringAccumulator acc(order, 64);
+
+    std::atomic<int> running{producer_count};
+    std::string drained;
+    std::thread writer([&] {
+        while (running.load() > 0)
+            drained += concat(acc.drain_segments());
+    });
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < producer_count; ++t)
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < fragments_per_producer; ++i)
+                acc.add('<', t, '.', i, '>');
+            acc.flush();
+            if (t % 2 == 0)
+                for (int i = fragments_per_producer; i < fragments_per_producer + extra_fragments; ++i)
+                    acc.add('<', t, '.', i, '>');
+            --running;
+        });
+    for (auto &producer : producers)
+        producer.join();
+    writer.join();
+    drained += concat(acc.drain_segments());
+
+    // fragments are never split, so the text parses back into "<t.i>" fragments
+    std::string text = drained + acc.str();
+    std::vector<int> next(producer_count, 0);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        assert(text[pos] == '<');
+        size_t dot = text.find('.', pos);
+        size_t close = text.find('>', pos);
+        assert(dot != std::string::npos && close != std::string::npos && dot < close);
+        int t = std::stoi(text.substr(pos + 1, dot - pos - 1));
+        int i = std::stoi(text.substr(dot + 1, close - dot - 1));
+        assert(t >= 0 && t < producer_count);
+        assert(i == next[t]++); // each fragment once, in order
+        pos = close + 1;
+    }
+    for (int t = 0; t < producer_count; ++t)
+        assert(next[t] == fragments_per_producer + (t % 2 == 0 ? extra_fragments : 0));
+}
+
+} // namespace
+
+int main() {
+    test_flush_hands_off_partial_segment();
+    test_drain_segments_keeps_sequence_order();
+    test_thread_and_accumulator_lifetimes();
+    test_drain_segments_while_producing(ConcurrentStringAccumulator::Order::per_thread);
+    test_drain_segments_while_producing(ConcurrentStringAccumulator::Order::sequence);
+    std::cout << "concurrent_string_accumulator_test: ok\n";
+    return 0;
+}
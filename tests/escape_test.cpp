@@ -0,0 +1,111 @@
+// Standalone test: g++ -std=c++17 -I.. escape_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using text_utils::EscapeProfile;
+
+namespace {
+
+const EscapeProfile profiles[] = {EscapeProfile::c, EscapeProfile::json, EscapeProfile::shell};
+
+/// escape() is sized exactly, and unescape() and unescape_in_place() both give back the original text.
+void check_round_trip(const std::string &input) {
+    for (EscapeProfile profile : profiles) {
+        std::string escaped = text_utils::escape(input, profile);
+        assert(text_utils::escaped_size(input, profile) == escaped.size());
+        assert(text_utils::unescape(escaped, profile) == input);
+
+        std::string in_place = escaped;
+        text_utils::unescape_in_place(in_place, profile);
+        assert(in_place == input);
+    }
+}
+
+void test_every_byte_round_trips() {
+    std::string all;
+    for (int c = 0; c < 256; ++c) {
+        std::string one(1, static_cast<char>(c));
+        check_round_trip(one);
+        check_round_trip(one + "0");
+        check_round_trip(one + "a");
+        check_round_trip("x" + one + "x");
+        all += one;
+    }
+    check_round_trip(all);
+    check_round_trip("");
+}
+
+void test_random_strings_round_trip() {
+    std::mt19937 rng(1);
+    // mostly characters an escape reacts to, so that escapes end up next to each other and next to digits
+    static const std::string alphabet = "\\\"'?/ \t\n\r\x01\x1b\x7f\x80\xff" "0178aAfFxXuU[$`";
+    for (int i = 0; i < 20000; ++i) {
+        std::string s(rng() % 24, '\0');
+        for (char &c : s)
+            c = rng() % 4 ? alphabet[rng() % alphabet.size()] : static_cast<char>(rng());
+        check_round_trip(s);
+    }
+}
+
+/// A control byte followed by a hex digit must not run into it, as "\x01" "a" would in C.
+void test_control_byte_before_hex_digit() {
+    assert(text_utils::escape("\x01" "a") == "\\001a");
+    assert(text_utils::escape("\x7f" "F") == "\\177F");
+    assert(text_utils::escape("\x01" "a", EscapeProfile::json) == "\\u0001a");
+    check_round_trip("\x01" "a");
+    check_round_trip("\x7f" "F");
+    check_round_trip("\x0f" "0");
+}
+
+/// The ANSI reset sequence ESC [ 0 m, whose '0' would extend an octal escape of ESC written with fewer digits.
+void test_ansi_reset_sequence() {
+    assert(text_utils::escape("\033[0m") == "\\033[0m");
+    assert(text_utils::escape("\033[0m", EscapeProfile::json) == "\\u001b[0m");
+    assert(text_utils::unescape("\\033[0m") == "\033[0m");
+    assert(text_utils::unescape("\\x1b[0m") == "\033[0m");
+    assert(text_utils::unescape("\\u001b[0m", EscapeProfile::json) == "\033[0m");
+    check_round_trip("\033[0m");
+    check_round_trip("\033[1;31mred\033[0m\n");
+}
+
+/// Surrogates only decode as a high/low pair; either half on its own has no UTF-8 form and is kept as text.
+void test_unpaired_surrogates_kept_verbatim() {
+    assert(text_utils::unescape("\\ud83d\\ude00", EscapeProfile::json) == "\xf0\x9f\x98\x80");
+    assert(text_utils::unescape("\\ud800", EscapeProfile::json) == "\\ud800");
+    assert(text_utils::unescape("\\udc00", EscapeProfile::json) == "\\udc00");
+    assert(text_utils::unescape("\\ud800x", EscapeProfile::json) == "\\ud800x");
+    assert(text_utils::unescape("\\ud800\\u0041", EscapeProfile::json) == "\\ud800A");
+    assert(text_utils::unescape("\\udc00\\ud800") == "\\udc00\\ud800");
+
+    std::string text = "a\\udfffb";
+    text_utils::unescape_in_place(text, EscapeProfile::json);
+    assert(text == "a\\udfffb");
+}
+
+/// An octal escape never goes past \377: the digit that would overflow a byte starts the following text instead.
+void test_octal_escape_stops_at_one_byte() {
+    assert(text_utils::unescape("\\377") == "\xff");
+    assert(text_utils::unescape("\\400") == " 0");
+    assert(text_utils::unescape("\\777") == "?7");
+    assert(text_utils::unescape("\\0") == std::string(1, '\0'));
+    assert(text_utils::unescape("\\1234") == "S4");
+}
+
+} // namespace
+
+int main() {
+    test_every_byte_round_trips();
+    test_random_strings_round_trip();
+    test_control_byte_before_hex_digit();
+    test_ansi_reset_sequence();
+    test_unpaired_surrogates_kept_verbatim();
+    test_octal_escape_stops_at_one_byte();
+    std::cout << "escape_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Standalone test: g++ -std=c++17 -I.. join_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// join(), str(), size() and operator<< all produce @p expected.
+template <typename Range>
+void check_join(const Range &elements, std::string_view separator, const std::string &expected) {
+    assert(text_utils::join(elements, separator) == expected);
+
+    auto view = text_utils::join_view(elements, separator);
+    assert(view.str() == expected);
+    assert(view.size() == expected.size());
+
+    std::ostringstream os;
+    os << view;
+    assert(os.str() == expected);
+}
+
+void test_strings() {
+    check_join(std::vector<std::string>{"a", "bc", "", "d"}, ", ", "a, bc, , d");
+    check_join(std::vector<std::string_view>{"x", "y"}, "", "xy");
+    check_join(std::vector<const char *>{"one", "two", "three"}, "-", "one-two-three");
+    check_join(std::list<std::string>{"only"}, ", ", "only");
+    check_join(std::set<std::string>{"b", "a"}, "/", "a/b");
+
+    // the non-template overload for a vector of strings
+    const std::vector<std::string> words = {"p", "q"};
+    assert(text_utils::join(words, " + ") == "p + q");
+}
+
+void test_empty_range() {
+    check_join(std::vector<std::string>{}, ", ", "");
+    check_join(std::vector<int>{}, ", ", "");
+    check_join(std::vector<std::string>{""}, ", ", "");
+    check_join(std::vector<std::string>{"", ""}, ", ", ", ");
+}
+
+/// Integers in decimal, floating point in shortest round-trip form.
+void test_numbers() {
+    check_join(std::vector<int>{1, -2, 30, 0}, ",", "1,-2,30,0");
+    check_join(std::array<int64_t, 2>{std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()}, " ",
+               "-9223372036854775808 9223372036854775807");
+    check_join(std::vector<unsigned>{7u, 4294967295u}, ";", "7;4294967295");
+    check_join(std::vector<double>{0.1, 1.5, -2.0, 1e300}, ", ", "0.1, 1.5, -2, 1e+300");
+    check_join(std::vector<float>{0.1f, 3.0f}, ", ", "0.1, 3");
+}
+
+/// chars are text, not small integers; bools are words.
+void test_chars_and_bools() {
+    check_join(std::vector<char>{'a', 'b', 'c'}, "", "abc");
+    check_join(std::string("xyz"), ".", "x.y.z");
+    check_join(std::vector<bool>{true, false, true}, "|", "true|false|true");
+    check_join(std::array<bool, 1>{false}, "|", "false");
+}
+
+/// size() is the exact length for every element type, which is what str() reserves.
+void test_size_matches_str() {
+    std::vector<double> doubles;
+    std::vector<long> longs;
+    for (int i = 0; i < 200; ++i) {
+        doubles.push_back(i * 1.0 / 7 - 10);
+        longs.push_back(static_cast<long>(i) * 1000003 - 99999999);
+    }
+    auto doubles_view = text_utils::join_view(doubles, ", ");
+    assert(doubles_view.size() == doubles_view.str().size());
+    auto longs_view = text_utils::join_view(longs, "");
+    assert(longs_view.size() == longs_view.str().size());
+}
+
+} // namespace
+
+int main() {
+    test_strings();
+    test_empty_range();
+    test_numbers();
+    test_chars_and_bools();
+    test_size_matches_str();
+    std::cout << "join_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Standalone test: g++ -std=c++17 -I.. line_index_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using text_utils::LineIndex;
+
+namespace {
+
+bool throws_out_of_range(void (*f)(const LineIndex &), const LineIndex &index) {
+    try {
+        f(index);
+    } catch (const std::out_of_range &) {
+        return true;
+    }
+    return false;
+}
+
+/// "\r\n" ends a line like "\n" does, and neither terminator byte is part of the line.
+void test_windows_line_endings() {
+    LineIndex index("one\r\ntwo\nthree\r\n");
+    assert(index.line_count() == 3);
+    assert(index.line(0) == "one");
+    assert(index.line(1) == "two");
+    assert(index.line(2) == "three");
+    assert(index.line_start(1) == 5);
+    assert(index.line_start(2) == 9);
+
+    // a lone '\r' is ordinary text
+    LineIndex lone("a\rb\n");
+    assert(lone.line_count() == 1);
+    assert(lone.line(0) == "a\rb");
+}
+
+/// A "\r\n" pair split across two update() calls still ends one line.
+void test_crlf_split_across_updates() {
+    std::string buffer = "first\r";
+    LineIndex index(buffer);
+    assert(index.line_count() == 1);
+
+    buffer += "\nsecond\r";
+    index.update(buffer);
+    assert(index.line_count() == 2);
+    assert(index.line(0) == "first");
+
+    buffer += "\n";
+    index.update(buffer);
+    assert(index.line_count() == 2);
+    assert(index.line(0) == "first");
+    assert(index.line(1) == "second");
+}
+
+/// As with std::getline, a final newline does not start an extra line, and empty text has no lines.
+void test_trailing_newline_and_empty_text() {
+    LineIndex empty("");
+    assert(empty.line_count() == 0);
+    assert(throws_out_of_range([](const LineIndex &i) { i.line(0); }, empty));
+    assert(throws_out_of_range([](const LineIndex &i) { i.line_of_offset(0); }, empty));
+
+    LineIndex def;
+    assert(def.line_count() == 0);
+
+    LineIndex unterminated("a\nb");
+    LineIndex terminated("a\nb\n");
+    assert(unterminated.line_count() == 2);
+    assert(terminated.line_count() == 2);
+    assert(terminated.line(1) == "b");
+    assert(throws_out_of_range([](const LineIndex &i) { i.line(2); }, terminated));
+
+    // blank lines in the middle and a lone newline still count
+    LineIndex blank("\n\nx\n");
+    assert(blank.line_count() == 3);
+    assert(blank.line(0).empty());
+    assert(blank.line(1).empty());
+    assert(blank.line(2) == "x");
+    assert(LineIndex("\n").line_count() == 1);
+}
+
+/// A terminator belongs to the line it ends.
+void test_line_of_offset_on_terminators() {
+    std::string text = "ab\r\ncd\nef";
+    LineIndex index(text);
+    for (size_t offset = 0; offset < text.size(); ++offset) {
+        size_t expected = offset <= 3 ? 0 : offset <= 6 ? 1 : 2;
+        assert(index.line_of_offset(offset) == expected);
+    }
+    assert(throws_out_of_range([](const LineIndex &i) { i.line_of_offset(9); }, index));
+
+    LineIndex blank("\n\n");
+    assert(blank.line_of_offset(0) == 0);
+    assert(blank.line_of_offset(1) == 1);
+}
+
+/// Text shorter than what was indexed is not an extension of it, so the index starts over.
+void test_update_with_shorter_text_resets() {
+    std::string longer = "a\nb\nc\nd";
+    LineIndex index(longer);
+    assert(index.line_count() == 4);
+
+    std::string shorter = "xyz\nw";
+    index.update(shorter);
+    assert(index.line_count() == 2);
+    assert(index.line(0) == "xyz");
+    assert(index.line(1) == "w");
+    assert(index.line_start(1) == 4);
+    assert(index.line_of_offset(4) == 1);
+
+    std::string none = "q";
+    index.update(none);
+    assert(index.line_count() == 1);
+    assert(index.line(0) == "q");
+}
+
+} // namespace
+
+int main() {
+    test_windows_line_endings();
+    test_crlf_split_across_updates();
+    test_trailing_newline_and_empty_text();
+    test_line_of_offset_on_terminators();
+    test_update_with_shorter_text_resets();
+    std::cout << "line_index_test: ok\n";
+    return 0;
+}
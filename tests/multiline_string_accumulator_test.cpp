@@ -0,0 +1,276 @@
+// Standalone test: g++ -std=c++17 -pthread -I.. multiline_string_accumulator_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using text_utils::MultilineStringAccumulator;
+
+namespace text_utils {
+
+struct MultilineStringAccumulatorInspector {
+    /// Number of levels of the rope, found without recursion so that a degenerate rope cannot overflow the stack.
+    static size_t depth(const MultilineStringAccumulator &acc) {
+        size_t deepest = 0;
+        std::vector<std::pair<const MultilineStringAccumulator::LineNode *, size_t>> stack;
+        if (acc.root_)
+            stack.emplace_back(acc.root_.get(), 1);
+        while (!stack.empty()) {
+            auto [node, depth] = stack.back();
+            stack.pop_back();
+            deepest = std::max(deepest, depth);
+            for (const auto *child : {node->left.get(), node->right.get()})
+                if (child)
+                    stack.emplace_back(child, depth + 1);
+        }
+        return deepest;
+    }
+};
+
+} // namespace text_utils
+
+namespace {
+
+/// A random binary tree of n nodes is about 4.3 ln n deep; a degenerate one is n deep.
+bool is_balanced(const MultilineStringAccumulator &acc) {
+    return text_utils::MultilineStringAccumulatorInspector::depth(acc) <= 100;
+}
+
+std::string join_lines(const std::vector<std::string> &lines) { return text_utils::join(lines, "\n"); }
+
+/// Splicing the same block in again and again must not degenerate the rope into a list.
+void test_repeated_block_insertion() {
+    MultilineStringAccumulator block;
+    block.add("a");
+    block.indent();
+    block.add("b");
+
+    MultilineStringAccumulator acc;
+    std::vector<std::string> expected;
+    const size_t repeats = 200000;
+    for (size_t i = 0; i < repeats; ++i) {
+        acc.insert_lines(acc.line_count(), block);
+        expected.push_back("a");
+        expected.push_back("    b");
+        if (i % 10000 == 0)
+            assert(is_balanced(acc));
+    }
+    assert(acc.line_count() == 2 * repeats);
+    assert(is_balanced(acc));
+
+    for (size_t i = 0; i < 1000; ++i) {
+        acc.insert_line(acc.line_count() / 2, "x");
+        acc.remove_line(acc.line_count() / 2);
+    }
+    assert(is_balanced(acc));
+    acc.insert_line(1, "mid");
+    expected.insert(expected.begin() + 1, "mid");
+    assert(acc.str() == join_lines(expected));
+}
+
+/// Doubling by inserting an accumulator into itself shares every node; depth must stay logarithmic.
+void test_self_doubling() {
+    MultilineStringAccumulator acc;
+    acc.add("line");
+    for (int i = 0; i < 20; ++i)
+        acc.insert_lines(0, acc);
+    assert(acc.line_count() == size_t(1) << 20);
+    assert(is_balanced(acc));
+
+    acc.insert_line(acc.line_count() / 2, "middle");
+    acc.remove_line(0);
+    assert(acc.line_count() == size_t(1) << 20);
+    assert(acc.str().size() == ((size_t(1) << 20) - 1) * 5 + 6); // "line" lines, one "middle" line, newlines between
+}
+
+/// insert_lines() only reads its argument, so threads may splice one template, appended lines included, at once.
+void test_concurrent_splicing_of_shared_template() {
+    MultilineStringAccumulator template_lines;
+    template_lines.add("header");
+    template_lines.insert_line(0, "first"); // some lines in the rope, the rest still appended
+    for (int i = 0; i < 100; ++i)
+        template_lines.add("line ", i);
+    const MultilineStringAccumulator &shared = template_lines;
+    const std::string expected = shared.str();
+
+    std::vector<MultilineStringAccumulator> results(2);
+    std::vector<std::thread> threads;
+    for (auto &result : results)
+        threads.emplace_back([&shared, &result] {
+            for (int i = 0; i < 50; ++i)
+                result.insert_lines(result.line_count(), shared);
+        });
+    for (auto &thread : threads)
+        thread.join();
+
+    for (const auto &result : results)
+        assert(result.line_count() == 50 * shared.line_count());
+    assert(results[0].str() == results[1].str());
+    assert(results[0].str().substr(0, expected.size()) == expected);
+    assert(shared.str() == expected);
+}
+
+/// insert_lines() nests the other accumulator at the current level, wherever indent() and unindent() left it.
+void test_insert_lines_at_current_level() {
+    MultilineStringAccumulator block;
+    block.add("x");
+    block.indent();
+    block.add("y");
+
+    MultilineStringAccumulator acc;
+    acc.add("a");
+    acc.indent();
+    acc.insert_lines(1, block);
+    assert(acc.str() == "a\n    x\n        y");
+
+    acc.unindent();
+    acc.insert_lines(0, block);
+    assert(acc.str() == "x\n    y\na\n    x\n        y");
+
+    acc.unindent(); // already at 0
+    acc.add("z");
+    assert(acc.str() == "x\n    y\na\n    x\n        y\nz");
+    assert(block.str() == "x\n    y");
+}
+
+/// Splicing an accumulator that itself contains a spliced one keeps every line's level relative to its block.
+void test_nested_splicing_keeps_relative_levels() {
+    MultilineStringAccumulator inner;
+    inner.add("i");
+    inner.indent();
+    inner.add("j");
+
+    MultilineStringAccumulator middle;
+    middle.add("m");
+    middle.indent();
+    middle.insert_lines(1, inner);
+    middle.add("n");
+    assert(middle.str() == "m\n    i\n        j\n    n");
+
+    MultilineStringAccumulator outer;
+    outer.add("o");
+    outer.indent();
+    outer.indent();
+    outer.insert_lines(1, middle);
+    assert(outer.str() == "o\n        m\n            i\n                j\n            n");
+
+    // the spliced lines are shared, but later edits on either side stay on that side
+    inner.add("k");
+    middle.remove_line(0);
+    assert(outer.str() == "o\n        m\n            i\n                j\n            n");
+    assert(middle.str() == "    i\n        j\n    n");
+}
+
+/// A model of the accumulator: every line with its final level.
+using Lines = std::vector<std::pair<size_t, std::string>>;
+
+std::string render(const Lines &lines) {
+    std::vector<std::string> out;
+    for (const auto &[level, text] : lines)
+        out.push_back(std::string(level * 4, ' ') + text);
+    return join_lines(out);
+}
+
+/// Random line edits inside spliced, shifted blocks exercise the shift push-down in split() and merge().
+void test_edits_inside_shifted_subtrees() {
+    std::mt19937 rng(32);
+    // a block with lines at several levels, partly in its rope and partly still appended
+    MultilineStringAccumulator block;
+    block.add("b0");
+    block.indent();
+    block.add("b1");
+    block.indent();
+    block.add("b2");
+    block.insert_line(0, "first");
+    block.unindent();
+    block.add("b3");
+    block.add("b4");
+    Lines block_lines = {{2, "first"}, {0, "b0"}, {1, "b1"}, {2, "b2"}, {1, "b3"}, {1, "b4"}};
+    assert(block.str() == render(block_lines));
+
+    MultilineStringAccumulator acc;
+    Lines expected;
+    size_t level = 0;
+    for (int op = 0; op < 3000; ++op) {
+        size_t at = rng() % (expected.size() + 1);
+        switch (rng() % 6) {
+        case 0:
+            acc.insert_lines(at, block);
+            for (size_t i = 0; i < block_lines.size(); ++i)
+                expected.insert(expected.begin() + static_cast<long>(at + i),
+                                {block_lines[i].first + level, block_lines[i].second});
+            break;
+        case 1:
+            acc.insert_line(at, "l" + std::to_string(op));
+            expected.insert(expected.begin() + static_cast<long>(at), {level, "l" + std::to_string(op)});
+            break;
+        case 2:
+        case 3:
+            if (!expected.empty()) {
+                at %= expected.size();
+                acc.remove_line(at);
+                expected.erase(expected.begin() + static_cast<long>(at));
+            }
+            break;
+        case 4:
+            acc.indent();
+            ++level;
+            break;
+        default:
+            acc.unindent();
+            level -= level > 0;
+            break;
+        }
+        assert(acc.line_count() == expected.size());
+        if (op % 50 == 0)
+            assert(acc.str() == render(expected));
+    }
+    assert(acc.str() == render(expected));
+    assert(is_balanced(acc));
+}
+
+/// What indent() returned before it was rewritten: every std::getline line, prefixed and newline terminated.
+std::string getline_indent(const std::string &text, int indent_level, int spaces_per_indent) {
+    std::istringstream iss(text);
+    std::string out;
+    for (std::string line; std::getline(iss, line);)
+        out += std::string(static_cast<size_t>(indent_level * spaces_per_indent), ' ') + line + '\n';
+    return out;
+}
+
+void test_indent_function() {
+    assert(text_utils::indent("", 2) == "");
+    assert(text_utils::indent("a", 1) == "    a\n");
+    assert(text_utils::indent("a\n", 1) == "    a\n");
+    assert(text_utils::indent("a\nb", 1, 2) == "  a\n  b\n");
+    assert(text_utils::indent("a\n\nb\n", 1, 2) == "  a\n  \n  b\n");
+    assert(text_utils::indent("\n", 1, 3) == "   \n");
+    assert(text_utils::indent("a\nb", 0) == "a\nb\n");
+    assert(text_utils::indent("a\nb", -1) == "a\nb\n"); // a negative level indents by nothing
+    assert(text_utils::indent("a", 2, -4) == "a\n");
+
+    for (const char *text : {"", "x", "x\n", "x\ny", "x\n\n\ny\n", "\n\n", " a\n\tb \n", "a\r\nb"})
+        for (int level : {0, 1, 3})
+            assert(text_utils::indent(text, level, 2) == getline_indent(text, level, 2));
+}
+
+} // namespace
+
+int main() {
+    test_repeated_block_insertion();
+    test_self_doubling();
+    test_concurrent_splicing_of_shared_template();
+    test_insert_lines_at_current_level();
+    test_nested_splicing_keeps_relative_levels();
+    test_edits_inside_shifted_subtrees();
+    test_indent_function();
+    std::cout << "multiline_string_accumulator_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Standalone test: g++ -std=c++17 -I.. newline_line_generator_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using text_utils::NewlineLineGenerator;
+using text_utils::Node;
+
+namespace {
+
+Node parse(const std::string &text) {
+    size_t pos = 0;
+    return text_utils::parse_block(text, pos);
+}
+
+std::vector<std::string> lines_of(NewlineLineGenerator &lines) {
+    std::vector<std::string> out;
+    for (std::string line; lines.next(line);)
+        out.push_back(line);
+    return out;
+}
+
+/// A block without children opens and closes on one line.
+void test_empty_blocks() {
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines("{}") == "{}\n");
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines("()") == "()\n");
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines("{a=1, b=(), c={}}") ==
+           "{\n"
+           "  a = 1,\n"
+           "  b = (),\n"
+           "  c = {}\n"
+           "}\n");
+}
+
+/// Keyed blocks open on their key's line; the comma after a block sits on its closing line.
+void test_nested_keyed_blocks() {
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines("{a={b={c=1}}, d=2}") ==
+           "{\n"
+           "  a = {\n"
+           "    b = {\n"
+           "      c = 1\n"
+           "    }\n"
+           "  },\n"
+           "  d = 2\n"
+           "}\n");
+}
+
+/// The opening bracket of an unkeyed block is not indented, while its contents and closing bracket are.
+void test_unkeyed_and_paren_blocks() {
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines("{{x=1},(2, 3),k=(p,{q=r}),{}}") ==
+           "{\n"
+           "{\n"
+           "    x = 1\n"
+           "  },\n"
+           "(\n"
+           "    2,\n"
+           "    3\n"
+           "  ),\n"
+           "  k = (\n"
+           "    p,\n"
+           "{\n"
+           "      q = r\n"
+           "    }\n"
+           "  ),\n"
+           "{}\n"
+           "}\n");
+}
+
+/// The generator yields the same lines, without newlines, whether it owns the tree or borrows it.
+void test_generator_on_owned_and_borrowed_trees() {
+    const std::string input = "{name=x, items=(1,{y=2}), empty={}}";
+    const std::vector<std::string> expected = {
+        "{", "  name = x,", "  items = (", "    1,", "{", "      y = 2", "    }", "  ),", "  empty = {}", "}",
+    };
+
+    NewlineLineGenerator owned(parse(input)); // the parsed temporary is moved into the generator
+    assert(lines_of(owned) == expected);
+    std::string line;
+    assert(!owned.next(line));
+
+    Node root = parse(input);
+    NewlineLineGenerator borrowed(root);
+    assert(lines_of(borrowed) == expected);
+
+    std::string joined;
+    for (const auto &l : expected)
+        joined += l + "\n";
+    assert(text_utils::format_nested_braces_string_recursive_with_newlines(input) == joined);
+}
+
+} // namespace
+
+int main() {
+    test_empty_blocks();
+    test_nested_keyed_blocks();
+    test_unkeyed_and_paren_blocks();
+    test_generator_on_owned_and_borrowed_trees();
+    std::cout << "newline_line_generator_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Standalone test: g++ -std=c++17 -I.. node_path_index_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using text_utils::Node;
+using text_utils::NodePathIndex;
+
+// The index points into the tree it was built from, so it cannot be built from a temporary one.
+static_assert(std::is_constructible_v<NodePathIndex, const Node &>);
+static_assert(std::is_constructible_v<NodePathIndex, Node &>);
+static_assert(!std::is_constructible_v<NodePathIndex, Node &&>);
+static_assert(!std::is_constructible_v<NodePathIndex, const Node &&>);
+
+namespace {
+
+Node parse(const std::string &text) {
+    size_t pos = 0;
+    return text_utils::parse_block(text, pos);
+}
+
+/// Keys containing separators are escaped instead of being split or colliding with nested paths.
+void test_keys_with_separators() {
+    Node root = parse("{path/to = 1, a.b = 2, a={b = 3, c = 4}, x* = 5}");
+    NodePathIndex index(root);
+
+    assert(index.find("path\\/to")->value == "1");
+    assert(index.find("a\\.b")->value == "2");
+    assert(index.find("a.b")->value == "3");
+    assert(index.find("a/c")->value == "4");
+    assert(index.find("x\\*")->value == "5");
+    assert(index.find("path/to") == nullptr);
+    assert(index.size() == 7);
+    assert(index.match("a.*").size() == 2);
+}
+
+/// A literal numeric key and a position never name the same node.
+void test_numeric_keys_and_positions() {
+    Node root = parse("{1 = literal, positional, 0 = zero}");
+    NodePathIndex index(root);
+
+    assert(index.find("\\1")->value == "literal");
+    assert(index.find("1")->value == "positional");
+    assert(index.find("\\0")->value == "zero");
+    assert(index.find("0") == nullptr); // the first child has a key, so it has no positional path
+    assert(NodePathIndex::escape_segment("12") == "\\12");
+}
+
+/// Later siblings sharing a key stay reachable through their position, subtrees included.
+void test_duplicate_keys() {
+    Node root = parse("{name={v = first}, name={v = second}}");
+    NodePathIndex index(root);
+
+    assert(index.find("name.v")->value == "first");
+    assert(index.find("1.v")->value == "second");
+    assert(index.size() == 5);
+    assert(index.match("**.v").size() == 2);
+}
+
+/// Matches come in document order, also when "**" reaches a later sibling directly and an earlier one by descending.
+void test_match_document_order() {
+    Node root = parse("{a={fov = 1, b={fov = 2}}, fov = 3, c={fov = 4}}");
+    NodePathIndex index(root);
+
+    std::vector<std::string> paths;
+    for (const auto &[path, node] : index.match("**.fov"))
+        paths.push_back(path + "=" + node->value);
+    assert((paths == std::vector<std::string>{"a.fov=1", "a.b.fov=2", "fov=3", "c.fov=4"}));
+
+    paths.clear();
+    for (const auto &[path, node] : index.match("*"))
+        paths.push_back(path);
+    assert((paths == std::vector<std::string>{"a", "fov", "c"}));
+}
+
+/// Copies own their lookup table; they stay valid after the original is gone.
+void test_copy_outlives_original() {
+    Node root = parse("{a={b = 1}, c = 2}");
+    auto original = std::make_unique<NodePathIndex>(root);
+    NodePathIndex copy(*original);
+    NodePathIndex moved(std::move(*original));
+    original.reset();
+
+    assert(copy.find("a.b")->value == "1");
+    assert(copy.find("a/b")->value == "1");
+    assert(moved.find("c")->value == "2");
+}
+
+} // namespace
+
+int main() {
+    test_keys_with_separators();
+    test_numeric_keys_and_positions();
+    test_duplicate_keys();
+    test_match_document_order();
+    test_copy_outlives_original();
+    std::cout << "node_path_index_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Standalone test: g++ -std=c++17 -pthread -I.. string_interner_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using text_utils::InternedNode;
+using text_utils::Node;
+using text_utils::StringInterner;
+
+namespace {
+
+bool same_tree(const Node &a, const Node &b) {
+    if (a.key != b.key || a.value != b.value || a.is_block != b.is_block || a.block_type != b.block_type ||
+        a.children.size() != b.children.size())
+        return false;
+    for (size_t i = 0; i < a.children.size(); ++i)
+        if (!same_tree(a.children[i], b.children[i]))
+            return false;
+    return true;
+}
+
+/// The interning parser produces the same tree as parse_block, with every distinct text stored once.
+void test_interned_parse_matches_parse_block() {
+    const std::string input = "{a = 1,{b}, c=(x, y = z), , d, a = 1, e={a = 1}}";
+    StringInterner strings;
+    size_t pos = 0;
+    InternedNode interned = text_utils::parse_block(input, pos, strings);
+    assert(pos == input.size());
+
+    size_t plain_pos = 0;
+    Node plain = text_utils::parse_block(input, plain_pos);
+    assert(same_tree(text_utils::to_node(interned, strings), plain));
+
+    assert(interned.children[0].key == interned.children[5].key);
+    assert(interned.children[0].key == interned.children[6].children[0].key);
+    assert(strings.view(interned.children[1].key).empty());
+    assert(strings.size() == 10); // "", a, 1, b, c, x, y, z, d, e
+}
+
+/// Ids are stable handles: interning again returns the same Id and view.
+void test_ids_and_views_are_stable() {
+    StringInterner strings(StringInterner::Sync::sharded, 16);
+    StringInterner::Id id = strings.intern("a string longer than one chunk");
+    std::string_view view = strings.view(id);
+    for (int i = 0; i < 1000; ++i)
+        strings.intern("filler " + std::to_string(i));
+    assert(strings.intern("a string longer than one chunk") == id);
+    assert(strings.view(id).data() == view.data());
+}
+
+/// With Sync::sharded, threads interning overlapping strings at once all agree on one Id per string.
+void test_concurrent_interning() {
+    const size_t thread_count = 8;
+    const size_t per_thread = 2000;
+    const size_t stride = 500; // neighbouring threads share three quarters of their strings
+    const size_t distinct = (thread_count - 1) * stride + per_thread;
+    StringInterner strings(StringInterner::Sync::sharded, 64);
+
+    auto text = [](size_t k) { return "string number " + std::to_string(k); };
+
+    // ids[t][j] is the Id thread t got for string t * stride + j
+    std::vector<std::vector<StringInterner::Id>> ids(thread_count, std::vector<StringInterner::Id>(per_thread));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; ++t)
+        threads.emplace_back([&, t] {
+            std::vector<size_t> order(per_thread);
+            for (size_t j = 0; j < per_thread; ++j)
+                order[j] = j;
+            std::shuffle(order.begin(), order.end(), std::mt19937(static_cast<unsigned>(t)));
+            for (size_t j : order) {
+                std::string s = text(t * stride + j);
+                StringInterner::Id id = strings.intern(s);
+                ids[t][j] = id;
+                assert(strings.view(id) == s); // readable while other threads are still interning
+                assert(strings.contains(s));
+            }
+        });
+    for (auto &thread : threads)
+        thread.join();
+
+    std::vector<StringInterner::Id> id_of(distinct);
+    std::vector<bool> seen(distinct, false);
+    for (size_t t = 0; t < thread_count; ++t)
+        for (size_t j = 0; j < per_thread; ++j) {
+            size_t k = t * stride + j;
+            if (seen[k])
+                assert(ids[t][j] == id_of[k]);
+            seen[k] = true;
+            id_of[k] = ids[t][j];
+        }
+
+    std::unordered_set<StringInterner::Id> unique_ids(id_of.begin(), id_of.end());
+    assert(unique_ids.size() == distinct);
+    for (size_t k = 0; k < distinct; ++k)
+        assert(strings.view(id_of[k]) == text(k));
+    assert(strings.size() == distinct);
+}
+
+} // namespace
+
+int main() {
+    test_interned_parse_matches_parse_block();
+    test_ids_and_views_are_stable();
+    test_concurrent_interning();
+    std::cout << "string_interner_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Standalone test: g++ -std=c++17 -I.. text_normalizer_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using text_utils::TextNormalizer;
+
+namespace {
+
+/// Reference for TextNormalizer::trim_lines(): strip whitespace, '\r' included, from both ends of every line.
+std::string trim_lines(const std::string &input) {
+    std::string out;
+    size_t pos = 0;
+    while (true) {
+        size_t end = input.find('\n', pos);
+        std::string line = input.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        size_t first = line.find_first_not_of(" \t\v\f\r");
+        if (first != std::string::npos)
+            out += line.substr(first, line.find_last_not_of(" \t\v\f\r") - first + 1);
+        if (end == std::string::npos)
+            return out;
+        out += '\n';
+        pos = end + 1;
+    }
+}
+
+/// Reference for TextNormalizer::cap_blank_lines(): drop blank lines past the first @p max_blank of every run.
+std::string cap_blank_lines(const std::string &input, size_t max_blank) {
+    std::string out;
+    size_t run = 0;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        size_t end = input.find('\n', pos);
+        size_t next = end == std::string::npos ? input.size() : end + 1;
+        std::string line = input.substr(pos, next - pos);
+        pos = next;
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) {
+            if (++run > max_blank)
+                continue;
+        } else {
+            run = 0;
+        }
+        out += line;
+    }
+    return out;
+}
+
+/// A stage added to a TextNormalizer together with the free function (or reference) it must behave like.
+struct Stage {
+    std::function<void(TextNormalizer &)> add;
+    std::function<std::string(const std::string &)> reference;
+};
+
+std::vector<Stage> all_stages() {
+    return {
+        {[](TextNormalizer &n) { n.trim(); }, [](const std::string &s) { return text_utils::trim(s); }},
+        {[](TextNormalizer &n) { n.trim_lines(); }, [](const std::string &s) { return trim_lines(s); }},
+        {[](TextNormalizer &n) { n.join_lines(); }, [](const std::string &s) { return text_utils::join_multiline(s); }},
+        {[](TextNormalizer &n) { n.join_lines(true); },
+         [](const std::string &s) { return text_utils::join_multiline(s, true); }},
+        {[](TextNormalizer &n) { n.collapse_whitespace(); },
+         [](const std::string &s) { return text_utils::collapse_whitespace(s); }},
+        {[](TextNormalizer &n) { n.remove_newlines(); },
+         [](const std::string &s) { return text_utils::remove_newlines(s); }},
+        {[](TextNormalizer &n) { n.remove_consecutive_duplicates(); },
+         [](const std::string &s) { return text_utils::remove_consecutive_duplicates(s); }},
+        {[](TextNormalizer &n) { n.remove_consecutive_duplicates(" a,"); },
+         [](const std::string &s) { return text_utils::remove_consecutive_duplicates(s, " a,"); }},
+        {[](TextNormalizer &n) { n.cap_blank_lines(1); }, [](const std::string &s) { return cap_blank_lines(s, 1); }},
+    };
+}
+
+/// apply() with a random chain of stages gives the same text as running the stages one after another.
+void check_random_chains(const std::vector<std::string> &inputs, std::mt19937 &rng) {
+    std::vector<Stage> stages = all_stages();
+    for (const std::string &input : inputs) {
+        TextNormalizer normalizer;
+        std::string expected = input;
+        size_t length = 1 + rng() % 4;
+        for (size_t i = 0; i < length; ++i) {
+            const Stage &stage = stages[rng() % stages.size()];
+            stage.add(normalizer);
+            expected = stage.reference(expected);
+        }
+        assert(normalizer.apply(input) == expected);
+    }
+}
+
+std::string random_text(std::mt19937 &rng, size_t length) {
+    static const std::string alphabet = "ab,,  \t\n\n\r\v.";
+    std::string text;
+    text.reserve(length);
+    for (size_t i = 0; i < length; ++i)
+        text += alphabet[rng() % alphabet.size()];
+    return text;
+}
+
+/// Short inputs exercise the stages on their own and in chains.
+void test_short_inputs_match_chained_functions() {
+    std::mt19937 rng(1);
+    std::vector<std::string> inputs{"", " ", "\n", "\r\n", "a", "  a  b  ", "\n\n\n a \n\n\n"};
+    for (int i = 0; i < 20000; ++i)
+        inputs.push_back(random_text(rng, rng() % 40));
+    check_random_chains(inputs, rng);
+}
+
+/// Inputs larger than one 16 KiB block carry whitespace runs, duplicate runs and blank lines across blocks.
+void test_inputs_spanning_blocks_match_chained_functions() {
+    std::mt19937 rng(2);
+    const size_t block = 16 * 1024;
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 40; ++i)
+        inputs.push_back(random_text(rng, 3 * block + rng() % block));
+
+    // runs placed right on the block boundaries
+    for (size_t offset : {block - 1, block, block + 1}) {
+        std::string text(offset - 3, 'a');
+        inputs.push_back(text + std::string(4000, ' ') + "b" + std::string(4000, '\n') + "c");
+        inputs.push_back(text + "\r\n \t\n\n\n  \n" + std::string(2 * block, ',') + "d  ");
+        inputs.push_back(std::string(offset, ' ') + text + std::string(offset, '\n'));
+    }
+    for (int round = 0; round < 20; ++round)
+        check_random_chains(inputs, rng);
+}
+
+} // namespace
+
+int main() {
+    test_short_inputs_match_chained_functions();
+    test_inputs_spanning_blocks_match_chained_functions();
+    std::cout << "text_normalizer_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Standalone test: g++ -std=c++17 -I.. tokenizer_test.cpp ../text_utils.cpp && ./a.out
+
+#include "text_utils.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using text_utils::Tokenizer;
+using TokenKind = Tokenizer::TokenKind;
+
+namespace {
+
+/// Reference for Tokenizer::split() and split_on_any_of(): cut at every character of @p delimiters.
+std::vector<std::string> naive_split(const std::string &input, const std::string &delimiters) {
+    std::vector<std::string> pieces(1);
+    for (char c : input) {
+        if (delimiters.find(c) != std::string::npos)
+            pieces.emplace_back();
+        else
+            pieces.back() += c;
+    }
+    return pieces;
+}
+
+/// find_delimiter() agrees with std::string_view::find_first_of from every start position, past the end included.
+void check_find_delimiter(const std::string &input, const std::string &delimiters) {
+    Tokenizer tokenizer(delimiters, "");
+    std::string_view view(input);
+    for (size_t pos = 0; pos <= input.size() + 1; ++pos)
+        assert(tokenizer.find_delimiter(view, pos) == view.find_first_of(delimiters, pos));
+    assert(tokenizer.find_delimiter(view, std::string_view::npos) == std::string_view::npos);
+    assert(tokenizer.find_delimiter(view, std::string_view::npos - 3) == std::string_view::npos);
+}
+
+/// Random inputs and delimiter sets of 1 to 10 characters, so both the vector scan and the table scan are used.
+void test_find_delimiter_matches_naive_search() {
+    std::mt19937 rng(30);
+    const std::string alphabet = "abc,;:|{}()= \t\n\x01\x7f\x80\xff";
+    for (int round = 0; round < 3000; ++round) {
+        std::string delimiters;
+        size_t delimiter_count = 1 + rng() % 10;
+        for (size_t i = 0; i < delimiter_count; ++i)
+            delimiters += alphabet[rng() % alphabet.size()];
+
+        std::string input;
+        size_t length = rng() % 100;
+        for (size_t i = 0; i < length; ++i)
+            input += rng() % 8 == 0 ? alphabet[rng() % alphabet.size()] : 'x';
+
+        check_find_delimiter(input, delimiters);
+        std::vector<std::string> expected = naive_split(input, delimiters);
+        std::vector<std::string_view> pieces = Tokenizer(delimiters, "").split(input);
+        assert(pieces.size() == expected.size());
+        for (size_t i = 0; i < pieces.size(); ++i)
+            assert(pieces[i] == expected[i]);
+        assert(text_utils::split_on_any_of(input, delimiters) == expected);
+    }
+}
+
+/// The first 32 bytes are scanned one at a time and the rest 16 at a time; a lone delimiter is found on either side.
+void test_scalar_vector_boundary() {
+    for (const std::string delimiters : {",", ",;:|=#", ",;:|=#@!"}) {
+        for (size_t length : {31, 32, 33, 47, 48, 49, 63, 64, 65, 100}) {
+            for (size_t at = 0; at < length; ++at) {
+                std::string input(length, 'x');
+                input[at] = delimiters.back();
+                check_find_delimiter(input, delimiters);
+            }
+            check_find_delimiter(std::string(length, 'x'), delimiters);
+        }
+    }
+
+    // the scan starts partway through, with the delimiter in the first or in a later 16 byte block
+    std::string input(80, 'x');
+    input[40] = ',';
+    input[70] = ',';
+    Tokenizer tokenizer(",");
+    assert(tokenizer.find_delimiter(input, 5) == 40);
+    assert(tokenizer.find_delimiter(input, 40) == 40);
+    assert(tokenizer.find_delimiter(input, 41) == 70);
+    assert(tokenizer.find_delimiter(input, 71) == std::string_view::npos);
+}
+
+/// Delimiters are single-character tokens and the text between them is trimmed, possibly to nothing.
+void test_tokenize() {
+    Tokenizer tokenizer("=,{}");
+    std::string input = "{ key = value ,, \t}";
+    std::vector<Tokenizer::Token> tokens = tokenizer.tokenize(input);
+
+    std::vector<std::pair<TokenKind, std::string>> expected = {
+        {TokenKind::delimiter, "{"}, {TokenKind::text, "key"},      {TokenKind::delimiter, "="},
+        {TokenKind::text, "value"},  {TokenKind::delimiter, ","},   {TokenKind::delimiter, ","},
+        {TokenKind::text, ""},       {TokenKind::delimiter, "}"},
+    };
+    assert(tokens.size() == expected.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        assert(tokens[i].kind == expected[i].first);
+        assert(tokens[i].text == expected[i].second);
+    }
+
+    // tokens are views into the input, not copies
+    assert(tokens[1].text.data() == input.data() + 2);
+
+    assert(tokenizer.tokenize("").empty());
+    size_t pos = 0;
+    assert(tokenizer.next("", pos).kind == TokenKind::end);
+
+    // with no whitespace characters configured nothing is trimmed
+    std::vector<Tokenizer::Token> raw = Tokenizer(",", "").tokenize(" a ,b");
+    assert(raw.size() == 3);
+    assert(raw[0].text == " a ");
+    assert(raw[2].text == "b");
+}
+
+/// split() keeps empty and untrimmed pieces, like split_on_any_of().
+void test_split() {
+    Tokenizer tokenizer(",;");
+    std::vector<std::string_view> pieces = tokenizer.split(",a ; b,,");
+    std::vector<std::string_view> expected = {"", "a ", " b", "", ""};
+    assert(pieces == expected);
+
+    assert(tokenizer.split("") == std::vector<std::string_view>{""});
+    assert(tokenizer.split("plain") == std::vector<std::string_view>{"plain"});
+    assert(text_utils::split_on_any_of("a/b\\c.d", "/\\.") == (std::vector<std::string>{"a", "b", "c", "d"}));
+}
+
+/// Past six distinct delimiters only the table scan is used; repeated characters in the set count once.
+void test_many_delimiters() {
+    std::string delimiters = ",;:|=#@!";
+    std::string input = "a,b;c:d|e=f#g@h!i";
+    std::vector<std::string> expected = {"a", "b", "c", "d", "e", "f", "g", "h", "i"};
+    assert(text_utils::split_on_any_of(input, delimiters) == expected);
+    assert(text_utils::split_on_any_of(input + input, delimiters + delimiters).size() == 17);
+
+    // seven characters but six distinct ones still take the vector scan, and must find the same positions
+    check_find_delimiter(std::string(40, 'x') + "|" + std::string(20, 'x'), ",,;:|=#");
+}
+
+} // namespace
+
+int main() {
+    test_find_delimiter_matches_naive_search();
+    test_scalar_vector_boundary();
+    test_tokenize();
+    test_split();
+    test_many_delimiters();
+    std::cout << "tokenizer_test: ok\n";
+    return 0;
+}
@@ -1,14 +1,278 @@
 #include "text_utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <iterator>
 #include <iostream>
-#include <regex>
+#include <limits>
+#include <queue>
 
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXT_UTILS_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TEXT_UTILS_NEON 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace text_utils {
 
-std::string remove_consecutive_duplicates(const std::string &input, const std::string &dedup_chars) {
+namespace {
+/// Index of the lowest set bit of @p mask, which must not be 0.
+inline size_t lowest_set_bit(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(mask));
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    size_t index = 0;
+    for (; !(mask & 1); mask >>= 1)
+        ++index;
+    return index;
+#endif
+}
+
+std::atomic<uint64_t> next_accumulator_id{1};
+/// Guards every thread's ThreadBuffers map and the Buffer::owner links into them.
+std::mutex thread_buffers_mutex;
+} // namespace
+
+/// The buffers one thread appends into, by accumulator id.
+struct ConcurrentStringAccumulator::ThreadBuffers {
+    std::unordered_map<uint64_t, Buffer *> by_accumulator;
+
+    ~ThreadBuffers() {
+        // the thread is exiting, its buffers stay with their accumulators
+        std::lock_guard<std::mutex> lock(thread_buffers_mutex);
+        for (auto &[id, buffer] : by_accumulator)
+            buffer->owner = nullptr;
+    }
+};
+
+ConcurrentStringAccumulator::ConcurrentStringAccumulator(Order order, size_t segment_size)
+    : id_(next_accumulator_id.fetch_add(1, std::memory_order_relaxed)), order_(order),
+      segment_size_(std::max<size_t>(segment_size, 1)) {}
+
+ConcurrentStringAccumulator::~ConcurrentStringAccumulator() {
+    {
+        std::lock_guard<std::mutex> lock(thread_buffers_mutex);
+        for (Buffer *b = buffers_.load(std::memory_order_acquire); b; b = b->next)
+            if (b->owner)
+                b->owner->by_accumulator.erase(id_);
+    }
+    clear();
+    Buffer *buffer = buffers_.load(std::memory_order_acquire);
+    while (buffer) {
+        Buffer *next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
+}
+
+ConcurrentStringAccumulator::Buffer &ConcurrentStringAccumulator::local_buffer() {
+    // accumulator ids are never reused, so a cache left pointing at a destroyed accumulator never matches again
+    thread_local uint64_t cached_id = 0;
+    thread_local Buffer *cached_buffer = nullptr;
+    thread_local ThreadBuffers thread_buffers;
+
+    if (cached_id == id_)
+        return *cached_buffer;
+
+    std::lock_guard<std::mutex> lock(thread_buffers_mutex);
+    Buffer *&buffer = thread_buffers.by_accumulator[id_];
+    if (!buffer) {
+        buffer = new Buffer;
+        buffer->owner = &thread_buffers;
+        buffer->next = buffers_.load(std::memory_order_relaxed);
+        while (!buffers_.compare_exchange_weak(buffer->next, buffer, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    cached_id = id_;
+    cached_buffer = buffer;
+    return *buffer;
+}
+
+void ConcurrentStringAccumulator::append(std::string_view fragment) {
+    Buffer &buffer = local_buffer();
+    if (!buffer.current) {
+        buffer.current = new Segment;
+        buffer.current->data.reserve(segment_size_);
+    }
+
+    Segment *segment = buffer.current;
+    segment->data += fragment;
+    if (order_ == Order::sequence)
+        segment->marks.emplace_back(next_sequence_.fetch_add(1, std::memory_order_relaxed), segment->data.size());
+
+    // fragments never straddle segments, a full segment is handed off whole
+    if (segment->data.size() >= segment_size_)
+        publish(buffer);
+}
+
+void ConcurrentStringAccumulator::flush() {
+    Buffer &buffer = local_buffer();
+    if (buffer.current && !buffer.current->data.empty())
+        publish(buffer);
+}
+
+void ConcurrentStringAccumulator::publish(Buffer &buffer) {
+    Segment *segment = buffer.current;
+    segment->next = buffer.published.load(std::memory_order_relaxed);
+    while (!buffer.published.compare_exchange_weak(segment->next, segment, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+    }
+    buffer.current = nullptr;
+}
+
+std::vector<ConcurrentStringAccumulator::Buffer *> ConcurrentStringAccumulator::buffers_in_order() const {
+    std::vector<Buffer *> ordered;
+    for (Buffer *b = buffers_.load(std::memory_order_acquire); b; b = b->next)
+        ordered.push_back(b);
+    std::reverse(ordered.begin(), ordered.end());
+    return ordered;
+}
+
+std::vector<const ConcurrentStringAccumulator::Segment *>
+ConcurrentStringAccumulator::segments_in_order(const Buffer &buffer) const {
+    std::vector<const Segment *> ordered;
+    for (const Segment *s = buffer.published.load(std::memory_order_acquire); s; s = s->next)
+        ordered.push_back(s);
+    std::reverse(ordered.begin(), ordered.end());
+    if (buffer.current)
+        ordered.push_back(buffer.current);
+    return ordered;
+}
+
+std::vector<std::string> ConcurrentStringAccumulator::drain_segments() {
+    std::vector<std::vector<Segment *>> per_thread;
+    for (Buffer *b : buffers_in_order()) {
+        // the producer only ever pushes onto published, so taking the whole list is a single exchange
+        Segment *head = b->published.exchange(nullptr, std::memory_order_acquire);
+
+        std::vector<Segment *> segments;
+        for (; head; head = head->next)
+            segments.push_back(head);
+        std::reverse(segments.begin(), segments.end());
+        per_thread.push_back(std::move(segments));
+    }
+
+    std::vector<std::string> drained;
+    if (order_ == Order::per_thread) {
+        for (auto &segments : per_thread)
+            for (Segment *segment : segments)
+                drained.push_back(std::move(segment->data));
+    } else {
+        std::vector<std::vector<const Segment *>> segments(per_thread.size());
+        for (size_t t = 0; t < per_thread.size(); ++t)
+            segments[t].assign(per_thread[t].begin(), per_thread[t].end());
+        std::string merged;
+        merge_by_sequence(segments, merged);
+        if (!merged.empty())
+            drained.push_back(std::move(merged));
+    }
+
+    for (auto &segments : per_thread)
+        for (Segment *segment : segments)
+            delete segment;
+    return drained;
+}
+
+std::string ConcurrentStringAccumulator::str() const {
+    std::string out;
+    out.reserve(size());
+
+    if (order_ == Order::per_thread) {
+        for (const Buffer *b : buffers_in_order())
+            for (const Segment *s : segments_in_order(*b))
+                out += s->data;
+        return out;
+    }
+
+    std::vector<std::vector<const Segment *>> per_thread;
+    for (const Buffer *b : buffers_in_order())
+        per_thread.push_back(segments_in_order(*b));
+    merge_by_sequence(per_thread, out);
+    return out;
+}
+
+void ConcurrentStringAccumulator::merge_by_sequence(const std::vector<std::vector<const Segment *>> &per_thread,
+                                                    std::string &out) {
+    // each thread's fragments are already in increasing sequence order, so a k-way merge over threads suffices
+    struct Fragment {
+        uint64_t sequence;
+        std::string_view text;
+    };
+    std::vector<std::vector<Fragment>> fragments(per_thread.size());
+    for (size_t t = 0; t < per_thread.size(); ++t) {
+        for (const Segment *s : per_thread[t]) {
+            size_t start = 0;
+            for (const auto &[sequence, end] : s->marks) {
+                fragments[t].push_back(Fragment{sequence, std::string_view(s->data).substr(start, end - start)});
+                start = end;
+            }
+        }
+    }
+
+    using Cursor = std::pair<size_t, size_t>; // (thread, fragment index)
+    auto later = [&](const Cursor &a, const Cursor &b) {
+        return fragments[a.first][a.second].sequence > fragments[b.first][b.second].sequence;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+    for (size_t t = 0; t < fragments.size(); ++t)
+        if (!fragments[t].empty())
+            heads.emplace(t, 0);
+
+    while (!heads.empty()) {
+        auto [t, i] = heads.top();
+        heads.pop();
+        out += fragments[t][i].text;
+        if (i + 1 < fragments[t].size())
+            heads.emplace(t, i + 1);
+    }
+}
+
+std::string ConcurrentStringAccumulator::drain() {
+    std::string out = str();
+    clear();
+    return out;
+}
+
+void ConcurrentStringAccumulator::clear() {
+    for (Buffer *b = buffers_.load(std::memory_order_acquire); b; b = b->next) {
+        Segment *head = b->published.exchange(nullptr, std::memory_order_acquire);
+        while (head) {
+            Segment *next = head->next;
+            delete head;
+            head = next;
+        }
+        delete b->current;
+        b->current = nullptr;
+    }
+}
+
+size_t ConcurrentStringAccumulator::size() const {
+    size_t total = 0;
+    for (const Buffer *b : buffers_in_order())
+        for (const Segment *s : segments_in_order(*b))
+            total += s->data.size();
+    return total;
+}
+
+std::string remove_consecutive_duplicates(std::string_view input, std::string_view dedup_chars) {
     if (input.empty())
         return "";
 
@@ -32,106 +296,140 @@ std::string remove_consecutive_duplicates(const std::string &input, const std::s
     return result;
 }
 
-std::string abbreviate_snake_case(const std::string &input) {
-    std::stringstream abbrev;
-    std::stringstream word_stream(input);
-    std::string word;
-
-    while (std::getline(word_stream, word, '_')) {
-        if (word.empty())
-            continue;
-        abbrev << word[0];
+std::string abbreviate_snake_case(std::string_view input) {
+    // the first character of every non-empty '_'-separated word
+    std::string abbrev;
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (input[i] != '_' && (i == 0 || input[i - 1] == '_'))
+            abbrev += input[i];
     }
-
-    return abbrev.str();
+    return abbrev;
 }
 
-bool is_integer(const std::string &str) {
-    // create a stringstream from the input string
-    std::stringstream ss(str);
-    // declare a temporary integer variable to hold the value
+bool is_integer(std::string_view str) {
+    // accepts what `stream >> int` followed by an eof check does: leading whitespace, an optional sign, and digits
+    // up to the end that fit in an int
+    size_t i = 0;
+    while (i < str.size() && std::isspace(static_cast<unsigned char>(str[i])))
+        ++i;
+    if (i < str.size() && str[i] == '+') {
+        ++i;
+        if (i < str.size() && str[i] == '-')
+            return false;
+    }
     int temp;
-    // try to extract an integer from the stringstream and ensure the whole string was processed
-    return (ss >> temp && ss.eof());
+    auto [end, ec] = std::from_chars(str.data() + i, str.data() + str.size(), temp);
+    return ec == std::errc() && end == str.data() + str.size();
 }
 
-bool is_rational(const std::string &value) {
-    static const std::regex rational_regex(R"(^-?(\d+|\.\d+)(\.\d+)?$)");
-    return std::regex_match(value, rational_regex);
+bool is_rational(std::string_view value) {
+    // hand-written match of ^-?(\d+|\.\d+)(\.\d+)?$
+    size_t i = 0;
+    auto digits = [&] {
+        size_t start = i;
+        while (i < value.size() && value[i] >= '0' && value[i] <= '9')
+            ++i;
+        return i > start;
+    };
+    auto fraction = [&] { return i < value.size() && value[i] == '.' && (++i, digits()); };
+
+    if (i < value.size() && value[i] == '-')
+        ++i;
+    if (!(digits() || fraction()))
+        return false;
+    if (i < value.size() && !fraction())
+        return false;
+    return i == value.size();
 }
 
-std::string add_newlines_to_long_string(const std::string &text, size_t max_chars_per_line) {
-    std::istringstream stream(text);
-    std::ostringstream formatted;
-    std::string word;
+std::string add_newlines_to_long_string(std::string_view text, size_t max_chars_per_line) {
+    std::string formatted;
     size_t current_line_length = 0;
 
-    while (stream >> word) {
+    auto is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && is_space(text[pos]))
+            ++pos;
+        if (pos == text.size())
+            break;
+        size_t word_end = pos;
+        while (word_end < text.size() && !is_space(text[word_end]))
+            ++word_end;
+        std::string_view word = text.substr(pos, word_end - pos);
+        pos = word_end;
+
         // If the word would exceed the line length, insert a newline first
         if (current_line_length + word.length() + (current_line_length > 0 ? 1 : 0) > max_chars_per_line) {
-            formatted << '\n';
+            formatted += '\n';
             current_line_length = 0;
         }
 
         // Add a space if this isn't the first word on the line
         if (current_line_length > 0) {
-            formatted << ' ';
+            formatted += ' ';
             current_line_length++;
         }
 
-        formatted << word;
+        formatted += word;
         current_line_length += word.length();
     }
 
-    return formatted.str();
+    return formatted;
 }
 
-std::vector<std::string> split(const std::string &str, const std::string &delimiter) {
+std::vector<std::string> split(std::string_view str, std::string_view delimiter) {
     std::vector<std::string> result;
     size_t pos = 0;
     size_t delim_pos;
     while ((delim_pos = str.find(delimiter, pos)) != std::string::npos) {
-        result.push_back(str.substr(pos, delim_pos - pos));
+        result.emplace_back(str.substr(pos, delim_pos - pos));
         pos = delim_pos + delimiter.length();
     }
-    result.push_back(str.substr(pos)); // add the remaining part
+    result.emplace_back(str.substr(pos)); // add the remaining part
     return result;
 }
 
-std::vector<std::string> split_once_from_right(const std::string &str, const std::string &delimiter) {
-    std::vector<std::string> result;
-    size_t delim_pos = str.rfind(delimiter);
+std::vector<std::string> split_once_from_right(std::string_view str, std::string_view delimiter) {
+    auto [left, right] = split_once_from_right_view(str, delimiter);
+    std::vector<std::string> result{std::string(left)};
+    if (right)
+        result.emplace_back(*right);
+    return result;
+}
 
-    if (delim_pos == std::string::npos) {
-        result.push_back(str);
-    } else {
-        result.push_back(str.substr(0, delim_pos));
-        result.push_back(str.substr(delim_pos + delimiter.length()));
-    }
+std::pair<std::string_view, std::optional<std::string_view>> split_once_from_right_view(std::string_view str,
+                                                                                        std::string_view delimiter) {
+    size_t delim_pos = str.rfind(delimiter);
+    if (delim_pos == std::string::npos)
+        return {str, std::nullopt};
+    return {str.substr(0, delim_pos), str.substr(delim_pos + delimiter.length())};
+}
 
+std::vector<std::string> split_on_any_of(std::string_view str, std::string_view delimiter_chars) {
+    Tokenizer tokenizer(delimiter_chars, "");
+    std::vector<std::string> result;
+    for (std::string_view piece : tokenizer.split(str))
+        result.emplace_back(piece);
     return result;
 }
 
-std::string join(const std::vector<std::string> &elements, const std::string &separator) {
-    std::ostringstream os;
-    for (size_t i = 0; i < elements.size(); ++i) {
-        if (i > 0)
-            os << separator;
-        os << elements[i];
-    }
-    return os.str();
+std::string join(const std::vector<std::string> &elements, std::string_view separator) {
+    return join_view(elements, separator).str();
 }
 
-std::string trim(const std::string &s) {
+std::string trim(std::string_view s) { return std::string(trim_view(s)); }
+
+std::string_view trim_view(std::string_view s) {
     size_t first = s.find_first_not_of(" \t\n\r");
     if (first == std::string::npos)
-        return "";
+        return std::string_view();
 
     size_t last = s.find_last_not_of(" \t\n\r");
     return s.substr(first, last - first + 1);
 }
 
-std::string pascal_to_snake_case(const std::string &input) {
+std::string pascal_to_snake_case(std::string_view input) {
     std::vector<std::string> parts;
     std::string current;
 
@@ -152,7 +450,7 @@ std::string pascal_to_snake_case(const std::string &input) {
     return join(parts, "_");
 }
 
-std::string snake_to_pascal_case(const std::string &input) {
+std::string snake_to_pascal_case(std::string_view input) {
     std::vector<std::string> parts = split(input, "_");
     for (std::string &part : parts) {
         if (!part.empty()) {
@@ -162,14 +460,14 @@ std::string snake_to_pascal_case(const std::string &input) {
     return join(parts, "");
 }
 
-std::string join_multiline(const std::string &input, bool replace_newlines_with_space) {
+std::string join_multiline(std::string_view input, bool replace_newlines_with_space) {
     std::string result;
     std::string buffer;
 
     for (char c : input) {
         if (c == '\n' || c == '\r') {
             // Trim trailing whitespace from buffer
-            while (!buffer.empty() && std::isspace(buffer.back()))
+            while (!buffer.empty() && std::isspace(static_cast<unsigned char>(buffer.back())))
                 buffer.pop_back();
 
             result += buffer;
@@ -179,7 +477,7 @@ std::string join_multiline(const std::string &input, bool replace_newlines_with_
                 result += ' ';
         } else {
             // Skip leading whitespace at start of a new line
-            if (buffer.empty() && std::isspace(c))
+            if (buffer.empty() && std::isspace(static_cast<unsigned char>(c)))
                 continue;
 
             buffer += c;
@@ -187,20 +485,20 @@ std::string join_multiline(const std::string &input, bool replace_newlines_with_
     }
 
     // Handle remaining buffer
-    while (!buffer.empty() && std::isspace(buffer.back()))
+    while (!buffer.empty() && std::isspace(static_cast<unsigned char>(buffer.back())))
         buffer.pop_back();
     result += buffer;
 
     return result;
 }
-std::string replace_char(const std::string &input, char from_char, char to_char) {
-    std::string result = input;
+std::string replace_char(std::string_view input, char from_char, char to_char) {
+    std::string result(input);
     std::replace(result.begin(), result.end(), from_char, to_char);
     return result;
 }
 
-std::string replace_chars(const std::string &input, const std::unordered_map<char, char> &mapping) {
-    std::string result = input;
+std::string replace_chars(std::string_view input, const std::unordered_map<char, char> &mapping) {
+    std::string result(input);
     for (char &c : result) {
         auto it = mapping.find(c);
         if (it != mapping.end()) {
@@ -213,34 +511,43 @@ std::string replace_chars(const std::string &input, const std::unordered_map<cha
 #include <string>
 
 // Replaces all occurrences of `from_substr` with `to_substr` in `input`
-std::string replace_substring(const std::string &input, const std::string &from_substr, const std::string &to_substr) {
+std::string replace_substring(std::string_view input, std::string_view from_substr, std::string_view to_substr) {
     if (from_substr.empty())
-        return input; // avoid infinite loop
-    std::string result = input;
-    size_t pos = 0;
+        return std::string(input); // avoid infinite loop
 
-    while ((pos = result.find(from_substr, pos)) != std::string::npos) {
-        result.replace(pos, from_substr.length(), to_substr);
-        pos += to_substr.length(); // move past the new substring
+    // copy the input once, substituting each match; replacements are never searched again
+    std::string result;
+    result.reserve(input.size());
+    size_t pos = 0;
+    size_t match;
+    while ((match = input.find(from_substr, pos)) != std::string_view::npos) {
+        result.append(input, pos, match - pos);
+        result += to_substr;
+        pos = match + from_substr.length();
     }
+    result.append(input, pos, std::string_view::npos);
 
     return result;
 }
 
-bool starts_with(const std::string &str, const std::string &prefix) {
+bool starts_with(std::string_view str, std::string_view prefix) {
     return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
 }
 
-bool contains(const std::string &str, const std::string &substr) { return str.find(substr) != std::string::npos; }
+bool contains(std::string_view str, std::string_view substr) { return str.find(substr) != std::string::npos; }
+
+std::string get_substring(std::string_view input, size_t start, size_t end) {
+    return std::string(get_substring_view(input, start, end));
+}
 
-std::string get_substring(const std::string &input, size_t start, size_t end) {
+std::string_view get_substring_view(std::string_view input, size_t start, size_t end) {
     if (start >= end || end > input.size()) {
-        return ""; // or throw std::out_of_range if you want stricter handling
+        return std::string_view(); // or throw std::out_of_range if you want stricter handling
     }
     return input.substr(start, end - start);
 }
 
-std::string remove_newlines(const std::string &input) {
+std::string remove_newlines(std::string_view input) {
     std::string result;
     result.reserve(input.size());
 
@@ -253,7 +560,7 @@ std::string remove_newlines(const std::string &input) {
     return result;
 }
 
-std::string collapse_whitespace(const std::string &input) {
+std::string collapse_whitespace(std::string_view input) {
     std::string result;
     result.reserve(input.size());
 
@@ -275,36 +582,822 @@ std::string collapse_whitespace(const std::string &input) {
     return result;
 }
 
-std::string replace_literal_newlines_with_real(const std::string &input) {
+void LineIndex::update(std::string_view text) {
+    size_t scanned = text_.size();
+    if (text.size() < scanned) {
+        // not an extension of the indexed text, start over
+        starts_.assign(1, 0);
+        scanned = 0;
+    }
+    text_ = text;
+
+    const char *data = text_.data();
+    size_t n = text_.size();
+    size_t i = scanned;
+    while (i < n) {
+        const void *hit = std::memchr(data + i, '\n', n - i);
+        if (!hit)
+            break;
+        i = static_cast<size_t>(static_cast<const char *>(hit) - data) + 1;
+        starts_.push_back(i);
+    }
+}
+
+size_t LineIndex::line_count() const {
+    // a start at the very end of the text belongs to a line that has not begun yet
+    return starts_.size() - (starts_.back() == text_.size() ? 1 : 0);
+}
+
+std::string_view LineIndex::line(size_t index) const {
+    if (index >= line_count()) {
+        throw std::out_of_range("line: index out of range");
+    }
+    size_t begin = starts_[index];
+    size_t end = text_.size();
+    if (index + 1 < starts_.size()) {
+        end = starts_[index + 1] - 1; // drop '\n'
+        if (end > begin && text_[end - 1] == '\r')
+            --end; // drop the '\r' of "\r\n"
+    }
+    return text_.substr(begin, end - begin);
+}
+
+size_t LineIndex::line_start(size_t index) const {
+    if (index >= line_count()) {
+        throw std::out_of_range("line_start: index out of range");
+    }
+    return starts_[index];
+}
+
+size_t LineIndex::line_of_offset(size_t offset) const {
+    if (offset >= text_.size()) {
+        throw std::out_of_range("line_of_offset: offset out of range");
+    }
+    return static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end(), offset) - starts_.begin()) - 1;
+}
+
+StringInterner::StringInterner(Sync sync, size_t chunk_size)
+    : sync_(sync), chunk_size_(chunk_size == 0 ? 1 : chunk_size),
+      shard_count_(sync == Sync::sharded ? SHARD_COUNT : 1), shards_(new Shard[shard_count_]) {}
+
+size_t StringInterner::shard_of(std::string_view s) const {
+    return shard_count_ == 1 ? 0 : std::hash<std::string_view>{}(s) % shard_count_;
+}
+
+std::string_view StringInterner::store(Shard &shard, std::string_view s) {
+    if (s.empty())
+        return std::string_view();
+
+    char *dest;
+    if (s.size() > chunk_size_) {
+        // oversized strings get a chunk of their own so the one being filled is not abandoned
+        shard.chunks.push_back(std::make_unique<char[]>(s.size()));
+        dest = shard.chunks.back().get();
+    } else {
+        if (s.size() > shard.remaining) {
+            shard.chunks.push_back(std::make_unique<char[]>(chunk_size_));
+            shard.cursor = shard.chunks.back().get();
+            shard.remaining = chunk_size_;
+        }
+        dest = shard.cursor;
+        shard.cursor += s.size();
+        shard.remaining -= s.size();
+    }
+    std::memcpy(dest, s.data(), s.size());
+    return std::string_view(dest, s.size());
+}
+
+StringInterner::Id StringInterner::intern(std::string_view s) {
+    size_t shard_index = shard_of(s);
+    Shard &shard = shards_[shard_index];
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (sync_ == Sync::sharded)
+        lock.lock();
+
+    uint32_t local;
+    if (auto it = shard.index.find(s); it != shard.index.end()) {
+        local = it->second;
+    } else {
+        if (shard.strings.size() > (std::numeric_limits<Id>::max() - shard_index) / shard_count_)
+            throw std::length_error("intern: out of ids");
+        local = static_cast<uint32_t>(shard.strings.size());
+        std::string_view stored = store(shard, s);
+        shard.strings.push_back(stored);
+        shard.index.emplace(stored, local);
+    }
+    // the low part of an id names the shard, so view() can find the string without a search
+    return static_cast<Id>(local * shard_count_ + shard_index);
+}
+
+std::string_view StringInterner::view(Id id) const {
+    const Shard &shard = shards_[id % shard_count_];
+    size_t local = id / shard_count_;
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (sync_ == Sync::sharded)
+        lock.lock();
+
+    if (local >= shard.strings.size()) {
+        throw std::out_of_range("view: unknown id");
+    }
+    return shard.strings[local];
+}
+
+bool StringInterner::contains(std::string_view s) const {
+    const Shard &shard = shards_[shard_of(s)];
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (sync_ == Sync::sharded)
+        lock.lock();
+    return shard.index.count(s) != 0;
+}
+
+size_t StringInterner::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < shard_count_; ++i) {
+        const Shard &shard = shards_[i];
+        std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+        if (sync_ == Sync::sharded)
+            lock.lock();
+        total += shard.strings.size();
+    }
+    return total;
+}
+
+TextNormalizer &TextNormalizer::trim() { return add_stage(Stage{StageKind::trim}); }
+
+TextNormalizer &TextNormalizer::trim_lines() { return add_stage(Stage{StageKind::trim_lines}); }
+
+TextNormalizer &TextNormalizer::join_lines(bool replace_newlines_with_space) {
+    Stage stage{StageKind::join_lines};
+    stage.replace_newlines_with_space = replace_newlines_with_space;
+    return add_stage(stage);
+}
+
+TextNormalizer &TextNormalizer::collapse_whitespace() { return add_stage(Stage{StageKind::collapse_whitespace}); }
+
+TextNormalizer &TextNormalizer::remove_newlines() { return add_stage(Stage{StageKind::remove_newlines}); }
+
+TextNormalizer &TextNormalizer::remove_consecutive_duplicates(std::string_view dedup_chars) {
+    Stage stage{StageKind::remove_consecutive_duplicates};
+    if (dedup_chars.empty())
+        stage.dedup.fill(true);
+    for (char c : dedup_chars)
+        stage.dedup[static_cast<unsigned char>(c)] = true;
+    return add_stage(stage);
+}
+
+TextNormalizer &TextNormalizer::cap_blank_lines(size_t max_blank) {
+    Stage stage{StageKind::cap_blank_lines};
+    stage.max_blank = max_blank;
+    return add_stage(stage);
+}
+
+/// Runtime state of one normalizer stage; which fields matter depends on the stage kind.
+struct TextNormalizer::NormalizerState {
+    std::string pending;   /**< Whitespace held back until it is known whether it is trailing. */
+    bool started = false;  /**< Seen non-whitespace (in the text, or in the current line for line stages). */
+    bool has_last = false; /**< Whether last is valid. */
+    char last = 0;         /**< Previous input character (dedup) or previous output character (join). */
+    size_t blank_run = 0;  /**< Consecutive blank lines seen. */
+};
+
+namespace {
+
+/// std::isspace in the "C" locale, as a table.
+const std::array<bool, 256> &space_table() {
+    static const std::array<bool, 256> table = [] {
+        std::array<bool, 256> t{};
+        for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+            t[c] = true;
+        return t;
+    }();
+    return table;
+}
+
+bool is_trim_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+} // namespace
+
+void TextNormalizer::run_stage(const Stage &stage, NormalizerState &st, std::string_view in, std::string &out) {
+    // No stage makes a block longer than its input plus the whitespace it was holding back, so the output is sized
+    // once and written through a pointer. The trimming stages only care about the ends of the text or of each line,
+    // so they copy everything in between with one memcpy and hold back only trailing whitespace in st.pending; the
+    // per-character stages are branch-free loops that always store and only advance when the character is kept.
+    const std::array<bool, 256> &whitespace = space_table();
+    auto is_ws = [&whitespace](char c) { return whitespace[static_cast<unsigned char>(c)]; };
+
+    size_t base = out.size();
+    out.resize(base + in.size() + st.pending.size());
+    char *w = out.data() + base;
+    const char *p = in.data();
+    const char *end = p + in.size();
+    auto put = [&](const char *from, const char *to) {
+        std::memcpy(w, from, static_cast<size_t>(to - from));
+        w += to - from;
+    };
+    auto flush_pending = [&] {
+        put(st.pending.data(), st.pending.data() + st.pending.size());
+        st.pending.clear();
+    };
+    auto skip = [](const char *from, const char *to, auto pred) {
+        while (from < to && pred(*from))
+            ++from;
+        return from;
+    };
+    auto skip_back = [](const char *from, const char *to, auto pred) {
+        while (to > from && pred(to[-1]))
+            --to;
+        return to;
+    };
+    auto find = [](const char *from, const char *to, char c) {
+        const void *hit = std::memchr(from, c, static_cast<size_t>(to - from));
+        return hit ? static_cast<const char *>(hit) : to;
+    };
+
+    switch (stage.kind) {
+    case StageKind::trim: {
+        if (!st.started) {
+            p = skip(p, end, is_trim_space);
+            st.started = p < end;
+        }
+        const char *last = skip_back(p, end, is_trim_space);
+        if (last > p) {
+            flush_pending();
+            put(p, last);
+        }
+        st.pending.append(last, end); // trailing so far
+        break;
+    }
+
+    case StageKind::trim_lines:
+    case StageKind::join_lines: {
+        bool join = stage.kind == StageKind::join_lines;
+        while (p < end) {
+            const char *eol = find(p, end, '\n');
+            if (join)
+                eol = find(p, eol, '\r');
+
+            // the part of the line in this block: leading whitespace dropped, trailing whitespace held back
+            if (!st.started)
+                p = skip(p, eol, is_ws);
+            const char *last = skip_back(p, eol, is_ws);
+            if (last > p) {
+                flush_pending();
+                put(p, last);
+                st.started = true;
+                st.has_last = true;
+                st.last = last[-1];
+            }
+            st.pending.append(last, eol);
+            if (eol == end)
+                break;
+
+            st.pending.clear();
+            st.started = false;
+            if (!join) {
+                *w++ = '\n';
+            } else if (stage.replace_newlines_with_space && st.has_last && st.last != ' ') {
+                *w++ = ' ';
+                st.last = ' ';
+            }
+            p = eol + 1;
+        }
+        break;
+    }
+
+    case StageKind::collapse_whitespace: {
+        bool in_run = st.started;
+        for (; p < end; ++p) {
+            bool ws = is_ws(*p);
+            *w = ws ? ' ' : *p;
+            w += !(ws && in_run);
+            in_run = ws;
+        }
+        st.started = in_run;
+        break;
+    }
+
+    case StageKind::remove_newlines:
+        for (; p < end; ++p) {
+            *w = *p;
+            w += (*p != '\n') & (*p != '\r');
+        }
+        break;
+
+    case StageKind::remove_consecutive_duplicates: {
+        if (p < end && !st.has_last) {
+            st.has_last = true;
+            st.last = *p;
+            *w++ = *p++;
+        }
+        char last = st.last;
+        for (; p < end; ++p) {
+            char c = *p;
+            *w = c;
+            w += !(stage.dedup[static_cast<unsigned char>(c)] && c == last);
+            last = c;
+        }
+        st.last = last;
+        break;
+    }
+
+    case StageKind::cap_blank_lines: {
+        auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+        while (p < end) {
+            const char *eol = find(p, end, '\n');
+            if (!st.started && skip(p, eol, blank) < eol) {
+                flush_pending();
+                st.started = true;
+            }
+            if (st.started)
+                put(p, eol);
+            else
+                st.pending.append(p, eol);
+            if (eol == end)
+                break;
+
+            if (st.started) {
+                st.blank_run = 0;
+                *w++ = '\n';
+            } else if (++st.blank_run <= stage.max_blank) {
+                flush_pending();
+                *w++ = '\n';
+            }
+            st.pending.clear();
+            st.started = false;
+            p = eol + 1;
+        }
+        break;
+    }
+    }
+
+    out.resize(static_cast<size_t>(w - out.data()));
+}
+
+std::string TextNormalizer::apply(std::string_view input) const {
+    // no stage ever makes the text longer
+    std::string out;
+    out.reserve(input.size());
+    if (stages_.empty()) {
+        out.assign(input);
+        return out;
+    }
+    std::vector<NormalizerState> states(stages_.size());
+
+    // The input is processed in blocks small enough that a stage's output is still in cache when the next stage
+    // reads it; the last stage writes straight to the result.
+    const size_t block_size = 16 * 1024;
+    std::string buffers[2];
+    auto run_from = [&](size_t first, std::string_view block) {
+        for (size_t k = first; k < stages_.size(); ++k) {
+            bool last = k + 1 == stages_.size();
+            std::string &target = last ? out : buffers[k % 2];
+            if (!last)
+                target.clear();
+            run_stage(stages_[k], states[k], block, target);
+            block = target;
+        }
+    };
+    for (size_t pos = 0; pos < input.size(); pos += block_size)
+        run_from(0, input.substr(pos, block_size));
+
+    // end of input: only a trailing whitespace-only line of cap_blank_lines can still produce output
+    for (size_t k = 0; k < stages_.size(); ++k) {
+        NormalizerState &st = states[k];
+        if (stages_[k].kind == StageKind::cap_blank_lines && !st.started && !st.pending.empty() &&
+            st.blank_run + 1 <= stages_[k].max_blank) {
+            std::string tail = std::move(st.pending);
+            if (k + 1 == stages_.size())
+                out += tail;
+            else
+                run_from(k + 1, tail);
+        }
+        st.pending.clear();
+    }
+    return out;
+}
+
+std::string replace_literal_newlines_with_real(std::string_view input) {
     std::string output;
     output.reserve(input.size());
 
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (input[i] == '\\' && i + 1 < input.size() && input[i + 1] == 'n') {
+    // only a backslash can start a replacement, so the text up to the next one is appended as a single run
+    const char *data = input.data();
+    size_t n = input.size();
+    size_t i = 0;
+    while (i < n) {
+        const void *hit = std::memchr(data + i, '\\', n - i);
+        size_t next = hit ? static_cast<size_t>(static_cast<const char *>(hit) - data) : n;
+        output.append(data + i, next - i);
+        i = next;
+        if (i >= n)
+            break;
+
+        if (i + 1 < n && data[i + 1] == 'n') {
             output.push_back('\n'); // real newline
-            ++i;                    // skip 'n'
+            i += 2;                 // skip 'n'
         } else {
-            output.push_back(input[i]);
+            output.push_back('\\');
+            ++i;
         }
     }
     return output;
 }
 
-std::string indent(const std::string &text, int indent_level, int spaces_per_indent) {
-    std::istringstream iss(text);
-    std::ostringstream oss;
-    std::string line;
-    std::string indent(indent_level * spaces_per_indent, ' ');
+namespace {
+
+/// Per-byte length of the escaped form; 1 means the byte is copied unchanged.
+using EscapeLengths = std::array<unsigned char, 256>;
+
+const EscapeLengths &escape_lengths(EscapeProfile profile) {
+    static const EscapeLengths c_lengths = [] {
+        EscapeLengths lengths;
+        lengths.fill(1);
+        for (int b = 0; b < 0x20; ++b)
+            lengths[b] = 4; // \ooo, octal because a hex escape would swallow a following hex digit
+        lengths[0x7f] = 4;
+        for (unsigned char b : {'\n', '\t', '\r', '\\', '"'})
+            lengths[b] = 2;
+        return lengths;
+    }();
+    static const EscapeLengths json_lengths = [] {
+        EscapeLengths lengths;
+        lengths.fill(1);
+        for (int b = 0; b < 0x20; ++b)
+            lengths[b] = 6; // \u00XX
+        for (unsigned char b : {'\n', '\t', '\r', '\b', '\f', '\\', '"'})
+            lengths[b] = 2;
+        return lengths;
+    }();
+    return profile == EscapeProfile::json ? json_lengths : c_lengths;
+}
+
+char simple_escape_letter(char c) {
+    switch (c) {
+    case '\n':
+        return 'n';
+    case '\t':
+        return 't';
+    case '\r':
+        return 'r';
+    case '\b':
+        return 'b';
+    case '\f':
+        return 'f';
+    default:
+        return c; // '\\' and '"' escape to themselves
+    }
+}
+
+/// Characters that never need quoting in a POSIX shell word.
+bool is_shell_safe(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || std::strchr("_@%+=:,./-", c) != nullptr;
+}
+
+bool is_shell_word(std::string_view input) {
+    return !input.empty() && std::all_of(input.begin(), input.end(), is_shell_safe);
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/// Parse exactly @p digits hex digits at @p p, which must have that many bytes available.
+bool parse_hex(const char *p, size_t digits, uint32_t &value) {
+    value = 0;
+    for (size_t i = 0; i < digits; ++i) {
+        int v = hex_value(p[i]);
+        if (v < 0)
+            return false;
+        value = value * 16 + static_cast<uint32_t>(v);
+    }
+    return true;
+}
+
+size_t encode_utf8(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xc0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xe0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xf0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+/**
+ * @brief Decode one C or JSON escape sequence starting at the backslash in[r].
+ * @return Number of input bytes consumed, or 0 if the sequence is not a valid escape.
+ */
+size_t decode_backslash_escape(const char *in, size_t n, size_t r, char *out, size_t &w, EscapeProfile profile) {
+    if (r + 1 >= n)
+        return 0;
+
+    char e = in[r + 1];
+    bool json = profile == EscapeProfile::json;
+    if (e >= '0' && e <= '7' && !json) {
+        // one to three octal digits, stopping before the value would pass 0377
+        size_t digits = 0;
+        uint32_t value = 0;
+        while (digits < 3 && r + 1 + digits < n && in[r + 1 + digits] >= '0' && in[r + 1 + digits] <= '7' &&
+               value * 8 + static_cast<uint32_t>(in[r + 1 + digits] - '0') <= 0377)
+            value = value * 8 + static_cast<uint32_t>(in[r + 1 + digits++] - '0');
+        out[w++] = static_cast<char>(value);
+        return 1 + digits;
+    }
+
+    char simple = 0;
+    switch (e) {
+    case 'n':
+        simple = '\n';
+        break;
+    case 't':
+        simple = '\t';
+        break;
+    case 'r':
+        simple = '\r';
+        break;
+    case 'b':
+        simple = '\b';
+        break;
+    case 'f':
+        simple = '\f';
+        break;
+    case '\\':
+    case '"':
+        simple = e;
+        break;
+    case '/':
+        if (json)
+            simple = e;
+        break;
+    case '\'':
+    case '?':
+        if (!json)
+            simple = e;
+        break;
+    case 'a':
+        if (!json)
+            simple = '\a';
+        break;
+    case 'v':
+        if (!json)
+            simple = '\v';
+        break;
+    default:
+        break;
+    }
+    if (simple) {
+        out[w++] = simple;
+        return 2;
+    }
+
+    if (e == 'x' && !json) {
+        // one or two hex digits
+        size_t digits = 0;
+        uint32_t value = 0;
+        while (digits < 2 && r + 2 + digits < n && hex_value(in[r + 2 + digits]) >= 0)
+            value = value * 16 + static_cast<uint32_t>(hex_value(in[r + 2 + digits++]));
+        if (digits == 0)
+            return 0;
+        out[w++] = static_cast<char>(value);
+        return 2 + digits;
+    }
+
+    if (e == 'u') {
+        uint32_t cp;
+        if (r + 6 > n || !parse_hex(in + r + 2, 4, cp))
+            return 0;
+        size_t consumed = 6;
+        uint32_t low;
+        if (cp >= 0xd800 && cp < 0xdc00 && r + 12 <= n && in[r + 6] == '\\' && in[r + 7] == 'u' &&
+            parse_hex(in + r + 8, 4, low) && low >= 0xdc00 && low < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            consumed = 12;
+        } else if (cp >= 0xd800 && cp < 0xe000) {
+            return 0; // an unpaired surrogate has no UTF-8 encoding
+        }
+        w += encode_utf8(cp, out + w);
+        return consumed;
+    }
+
+    return 0;
+}
+
+/// Copy in[from, to) to out[w...]; the ranges may be the same buffer with w <= from.
+void move_run(const char *in, size_t from, size_t to, char *out, size_t &w) {
+    if (out + w != in + from)
+        std::memmove(out + w, in + from, to - from);
+    w += to - from;
+}
+
+/**
+ * @brief Unescape @p n bytes from @p in into @p out, which may alias @p in.
+ *
+ * The output is never longer than the input, and the write position never overtakes the read position, which is
+ * what makes unescape_in_place possible.
+ *
+ * @return Number of bytes written.
+ */
+size_t unescape_into(const char *in, size_t n, char *out, EscapeProfile profile) {
+    size_t r = 0;
+    size_t w = 0;
+
+    if (profile != EscapeProfile::shell) {
+        while (r < n) {
+            const void *hit = std::memchr(in + r, '\\', n - r);
+            size_t backslash = hit ? static_cast<size_t>(static_cast<const char *>(hit) - in) : n;
+            move_run(in, r, backslash, out, w);
+            r = backslash;
+            if (r >= n)
+                break;
+
+            size_t consumed = decode_backslash_escape(in, n, r, out, w, profile);
+            if (consumed == 0) {
+                out[w++] = '\\'; // not an escape, keep it verbatim
+                consumed = 1;
+            }
+            r += consumed;
+        }
+        return w;
+    }
+
+    while (r < n) {
+        size_t special = r;
+        while (special < n && in[special] != '\'' && in[special] != '"' && in[special] != '\\')
+            ++special;
+        move_run(in, r, special, out, w);
+        r = special;
+        if (r >= n)
+            break;
+
+        char c = in[r++];
+        if (c == '\'') {
+            // single quotes: everything up to the closing quote is literal
+            const void *hit = std::memchr(in + r, '\'', n - r);
+            size_t close = hit ? static_cast<size_t>(static_cast<const char *>(hit) - in) : n;
+            move_run(in, r, close, out, w);
+            r = close < n ? close + 1 : n;
+        } else if (c == '"') {
+            // double quotes: backslash only escapes $ ` " \ and newline
+            while (r < n && in[r] != '"') {
+                if (in[r] == '\\' && r + 1 < n && std::strchr("$`\"\\\n", in[r + 1]) != nullptr) {
+                    if (in[r + 1] != '\n')
+                        out[w++] = in[r + 1];
+                    r += 2;
+                } else {
+                    out[w++] = in[r++];
+                }
+            }
+            if (r < n)
+                ++r; // closing quote
+        } else if (r < n) {
+            // unquoted backslash: the next character is literal, an escaped newline is a line continuation
+            if (in[r] != '\n')
+                out[w++] = in[r];
+            ++r;
+        } else {
+            out[w++] = '\\';
+        }
+    }
+    return w;
+}
+
+} // namespace
+
+size_t escaped_size(std::string_view input, EscapeProfile profile) {
+    if (profile == EscapeProfile::shell) {
+        if (is_shell_word(input))
+            return input.size();
+        size_t quotes = static_cast<size_t>(std::count(input.begin(), input.end(), '\''));
+        return input.size() + 2 + 3 * quotes; // ' becomes '\''
+    }
 
-    while (std::getline(iss, line)) {
-        oss << indent << line << '\n';
+    const EscapeLengths &lengths = escape_lengths(profile);
+    size_t total = 0;
+    for (char c : input)
+        total += lengths[static_cast<unsigned char>(c)];
+    return total;
+}
+
+std::string escape(std::string_view input, EscapeProfile profile) {
+    if (profile == EscapeProfile::shell && is_shell_word(input))
+        return std::string(input);
+
+    std::string out(escaped_size(input, profile), '\0');
+    char *w = out.data();
+
+    if (profile == EscapeProfile::shell) {
+        *w++ = '\'';
+        for (char c : input) {
+            if (c == '\'') {
+                std::memcpy(w, "'\\''", 4);
+                w += 4;
+            } else {
+                *w++ = c;
+            }
+        }
+        *w++ = '\'';
+        return out;
     }
 
-    return oss.str();
+    static const char hex_digits[] = "0123456789abcdef";
+    const EscapeLengths &lengths = escape_lengths(profile);
+    const char *data = input.data();
+    size_t n = input.size();
+    size_t i = 0;
+    while (i < n) {
+        size_t run_end = i;
+        while (run_end < n && lengths[static_cast<unsigned char>(data[run_end])] == 1)
+            ++run_end;
+        std::memcpy(w, data + i, run_end - i);
+        w += run_end - i;
+        i = run_end;
+        if (i >= n)
+            break;
+
+        unsigned char c = static_cast<unsigned char>(data[i++]);
+        *w++ = '\\';
+        switch (lengths[c]) {
+        case 2:
+            *w++ = simple_escape_letter(static_cast<char>(c));
+            break;
+        case 4:
+            *w++ = static_cast<char>('0' + (c >> 6));
+            *w++ = static_cast<char>('0' + ((c >> 3) & 7));
+            *w++ = static_cast<char>('0' + (c & 7));
+            break;
+        default:
+            std::memcpy(w, "u00", 3);
+            w += 3;
+            *w++ = hex_digits[c >> 4];
+            *w++ = hex_digits[c & 0xf];
+            break;
+        }
+    }
+    return out;
+}
+
+std::string unescape(std::string_view input, EscapeProfile profile) {
+    std::string out(input.size(), '\0');
+    out.resize(unescape_into(input.data(), input.size(), out.data(), profile));
+    return out;
 }
 
-std::string surround(const std::string &str, const std::string &left, const std::string &right) {
-    return left + str + (right.empty() ? left : right);
+void unescape_in_place(std::string &text, EscapeProfile profile) {
+    text.resize(unescape_into(text.data(), text.size(), text.data(), profile));
+}
+
+std::string indent(std::string_view text, int indent_level, int spaces_per_indent) {
+    if (text.empty())
+        return "";
+
+    size_t width = static_cast<size_t>(std::max(indent_level * spaces_per_indent, 0));
+    size_t lines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    if (text.back() != '\n')
+        ++lines; // last line is unterminated
+
+    // every line, including an unterminated last one, gets the prefix and a newline
+    std::string out;
+    out.reserve(text.size() + lines * width + 1);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        out.append(width, ' ');
+        out.append(text, pos, end - pos);
+        out += '\n';
+        pos = end + 1;
+    }
+    return out;
+}
+
+std::string surround(std::string_view str, std::string_view left, std::string_view right) {
+    std::string_view closing = right.empty() ? left : right;
+    std::string out;
+    out.reserve(left.size() + str.size() + closing.size());
+    out += left;
+    out += str;
+    out += closing;
+    return out;
 }
 
 std::string generate_abbreviation(const std::string &snake_case_name) {
@@ -329,36 +1422,139 @@ std::string generate_abbreviation(const std::string &snake_case_name) {
     return abbreviation;
 }
 
-std::string generate_unique_abbreviation(std::unordered_map<std::string, std::string> &current_abbreviation_map,
-                                         const std::string &word_to_abbreviate) {
+std::unordered_map<std::string, std::string> map_words_to_abbreviations(const std::vector<std::string> &words) {
+    std::unordered_map<std::string, std::string> word_to_abbreviation;
+    // abbreviations already handed out; words are only stored once, as keys of the returned map
+    std::unordered_set<std::string> taken;
 
-    std::string abbreviation = generate_abbreviation(word_to_abbreviate);
+    for (const auto &word : words) {
+        // a repeated word always gets the abbreviation it got the first time, so only new words are abbreviated
+        auto [it, inserted] = word_to_abbreviation.try_emplace(word);
+        if (!inserted)
+            continue;
 
-    if (auto it = current_abbreviation_map.find(abbreviation); it != current_abbreviation_map.end()) {
-        if (it->second != word_to_abbreviate) {
-            int suffix = 1;
-            std::string original_abbreviation = abbreviation;
-            while (current_abbreviation_map.find(abbreviation) != current_abbreviation_map.end() &&
-                   current_abbreviation_map[abbreviation] != word_to_abbreviate) {
-                abbreviation = original_abbreviation + std::to_string(suffix++);
-            }
-        }
+        std::string base = generate_abbreviation(word);
+        std::string abbr = base;
+        for (int suffix = 1; !taken.insert(abbr).second; ++suffix)
+            abbr = base + std::to_string(suffix);
+        it->second = std::move(abbr);
     }
 
-    current_abbreviation_map[abbreviation] = word_to_abbreviate;
-    return abbreviation;
+    return word_to_abbreviation;
 }
 
-std::unordered_map<std::string, std::string> map_words_to_abbreviations(const std::vector<std::string> &words) {
-    std::unordered_map<std::string, std::string> abbreviation_to_word;
-    std::unordered_map<std::string, std::string> word_to_abbreviation;
+Tokenizer::Tokenizer(std::string_view delimiters, std::string_view whitespace) {
+    for (char c : delimiters) {
+        if (is_delimiter(c))
+            continue;
+        classes_[static_cast<unsigned char>(c)] |= DELIMITER;
+        if (vector_delimiter_count_ < MAX_VECTOR_DELIMITERS)
+            vector_delimiters_[vector_delimiter_count_] = c;
+        ++vector_delimiter_count_;
+    }
+    for (char c : whitespace)
+        classes_[static_cast<unsigned char>(c)] |= WHITESPACE;
+}
 
-    for (const auto &word : words) {
-        std::string abbr = generate_unique_abbreviation(abbreviation_to_word, word);
-        word_to_abbreviation[word] = abbr;
+size_t Tokenizer::find_delimiter(std::string_view input, size_t pos) const {
+    const char *data = input.data();
+    size_t n = input.size();
+    if (pos >= n)
+        return std::string_view::npos; // also keeps the pos + k bounds checks below from wrapping
+
+#if defined(TEXT_UTILS_SSE2) || defined(TEXT_UTILS_NEON)
+    // most tokens are short, so the first 32 bytes are checked one at a time before paying for the vector setup
+    for (size_t head = std::min(n, pos + 32); pos < head; ++pos)
+        if (is_delimiter(data[pos]))
+            return pos;
+
+    size_t count = vector_delimiter_count_;
+    if (count <= MAX_VECTOR_DELIMITERS && pos + 16 <= n) {
+#if defined(TEXT_UTILS_SSE2)
+        __m128i needles[MAX_VECTOR_DELIMITERS];
+        for (size_t i = 0; i < count; ++i)
+            needles[i] = _mm_set1_epi8(vector_delimiters_[i]);
+        for (; pos + 16 <= n; pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+            __m128i hits = _mm_setzero_si128();
+            for (size_t i = 0; i < count; ++i)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[i]));
+            if (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits)))
+                return pos + lowest_set_bit(mask);
+        }
+#else
+        uint8x16_t needles[MAX_VECTOR_DELIMITERS];
+        for (size_t i = 0; i < count; ++i)
+            needles[i] = vdupq_n_u8(static_cast<uint8_t>(vector_delimiters_[i]));
+        for (; pos + 16 <= n; pos += 16) {
+            uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(data + pos));
+            uint8x16_t hits = vdupq_n_u8(0);
+            for (size_t i = 0; i < count; ++i)
+                hits = vorrq_u8(hits, vceqq_u8(chunk, needles[i]));
+            // narrow every byte of the comparison to 4 bits, giving a 64 bit mask with 4 bits per input byte
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+            if (mask)
+                return pos + lowest_set_bit(mask) / 4;
+        }
+#endif
+    }
+#endif
+
+    // unrolled table scan; the four lookups are independent loads, so they overlap instead of forming a chain
+    for (; pos + 4 <= n; pos += 4) {
+        unsigned char any = classes_[static_cast<unsigned char>(data[pos])] |
+                            classes_[static_cast<unsigned char>(data[pos + 1])] |
+                            classes_[static_cast<unsigned char>(data[pos + 2])] |
+                            classes_[static_cast<unsigned char>(data[pos + 3])];
+        if (any & DELIMITER)
+            break;
     }
+    for (; pos < n; ++pos)
+        if (is_delimiter(data[pos]))
+            return pos;
+    return std::string_view::npos;
+}
 
-    return word_to_abbreviation;
+std::string_view Tokenizer::scan_text(std::string_view input, size_t &pos) const {
+    size_t start = pos;
+    size_t end = find_delimiter(input, pos);
+    if (end == std::string_view::npos)
+        end = input.size();
+    pos = end;
+
+    while (start < end && is_whitespace(input[start]))
+        ++start;
+    while (end > start && is_whitespace(input[end - 1]))
+        --end;
+    return input.substr(start, end - start);
+}
+
+Tokenizer::Token Tokenizer::next(std::string_view input, size_t &pos) const {
+    if (pos >= input.size())
+        return Token{TokenKind::end, {}};
+    if (is_delimiter(input[pos]))
+        return Token{TokenKind::delimiter, input.substr(pos++, 1)};
+    return Token{TokenKind::text, scan_text(input, pos)};
+}
+
+std::vector<Tokenizer::Token> Tokenizer::tokenize(std::string_view input) const {
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    for (Token tok = next(input, pos); tok.kind != TokenKind::end; tok = next(input, pos))
+        tokens.push_back(tok);
+    return tokens;
+}
+
+std::vector<std::string_view> Tokenizer::split(std::string_view input) const {
+    std::vector<std::string_view> pieces;
+    size_t pos = 0;
+    size_t delim_pos;
+    while ((delim_pos = find_delimiter(input, pos)) != std::string_view::npos) {
+        pieces.push_back(input.substr(pos, delim_pos - pos));
+        pos = delim_pos + 1;
+    }
+    pieces.push_back(input.substr(pos)); // add the remaining part
+    return pieces;
 }
 
 /**
@@ -368,60 +1564,86 @@ std::unordered_map<std::string, std::string> map_words_to_abbreviations(const st
  *
  * @param s The input string.
  * @param pos The current parsing position (will be updated to after the token).
- * @return std::string The parsed token.
+ * @return std::string_view The parsed token, trimmed, as a view into @p s.
  */
-std::string parse_token(const std::string &s, size_t &pos) {
-    std::string tok;
-    while (pos < s.size() && s[pos] != '=' && s[pos] != ',' && s[pos] != '{' && s[pos] != '}' && s[pos] != '(' &&
-           s[pos] != ')') {
-        tok.push_back(s[pos++]);
-    }
-    return trim(tok);
+std::string_view parse_token(std::string_view s, size_t &pos) {
+    static const Tokenizer node_tokenizer("=,{}()");
+    return node_tokenizer.scan_text(s, pos);
 }
 
-Node parse_block(const std::string &s, size_t &pos) {
-    Node block;
-    block.is_block = true;
+/// How the parser stores the keys and values of a Node: as copies of the parsed text.
+struct CopyText {
+    void operator()(std::string &field, std::string_view text) const { field.assign(text); }
+};
 
-    if (pos < s.size() && (s[pos] == '{' || s[pos] == '(')) {
-        block.block_type = s[pos];
-        pos++; // consume opening
-    }
+/// How the parser stores the keys and values of an InternedNode: as ids of the parsed text.
+struct InternText {
+    StringInterner &strings;
+    void operator()(StringInterner::Id &field, std::string_view text) const { field = strings.intern(text); }
+};
 
-    char closing = (block.block_type == '{') ? '}' : ')';
+template <typename NodeT, typename Text> NodeT parse_block_as(std::string_view s, size_t &pos, const Text &text);
 
-    while (pos < s.size() && s[pos] != closing) {
-        Node child;
+/**
+ * @brief Parses the children of a block until its closing character or the position @p stop.
+ *
+ * @param s The input string.
+ * @param pos The current parsing position (will be updated to after the last parsed child and its comma).
+ * @param stop Position at which to stop; must be the start of a child, i.e. just after a top-level comma.
+ * @param closing The closing character of the enclosing block.
+ * @param children Receives the parsed children.
+ * @param text Stores a parsed key or value into a field of NodeT.
+ */
+template <typename NodeT, typename Text>
+void parse_children(std::string_view s, size_t &pos, size_t stop, char closing, std::vector<NodeT> &children,
+                    const Text &text) {
+    while (pos < s.size() && pos < stop && s[pos] != closing) {
+        NodeT child;
 
         size_t lookahead = pos;
-        std::string tok = parse_token(s, lookahead);
+        std::string_view tok = parse_token(s, lookahead);
 
         if (lookahead < s.size() && s[lookahead] == '=') {
-            std::string key = tok;
+            std::string_view key = tok;
             pos = lookahead + 1;
 
             if (pos < s.size() && (s[pos] == '{' || s[pos] == '(')) {
-                Node inner = parse_block(s, pos);
-                inner.key = trim(key);
+                NodeT inner = parse_block_as<NodeT>(s, pos, text);
+                text(inner.key, key);
                 child = std::move(inner);
             } else {
-                child.key = key;
-                child.value = parse_token(s, pos);
+                text(child.key, key);
+                text(child.value, parse_token(s, pos));
                 child.is_block = false;
             }
         } else if (pos < s.size() && (s[pos] == '{' || s[pos] == '(')) {
-            child = parse_block(s, pos);
-            child.key = "";
+            child = parse_block_as<NodeT>(s, pos, text);
+            text(child.key, {});
         } else {
-            child.value = parse_token(s, pos);
+            text(child.key, {});
+            text(child.value, parse_token(s, pos));
             child.is_block = false;
         }
 
-        block.children.push_back(child);
+        children.push_back(std::move(child));
 
         if (pos < s.size() && s[pos] == ',')
             pos++; // consume comma
     }
+}
+
+template <typename NodeT, typename Text> NodeT parse_block_as(std::string_view s, size_t &pos, const Text &text) {
+    NodeT block;
+    text(block.value, {});
+    block.is_block = true;
+
+    if (pos < s.size() && (s[pos] == '{' || s[pos] == '(')) {
+        block.block_type = s[pos];
+        pos++; // consume opening
+    }
+
+    char closing = (block.block_type == '{') ? '}' : ')';
+    parse_children(s, pos, std::string::npos, closing, block.children, text);
 
     if (pos < s.size() && s[pos] == closing)
         pos++; // consume closing
@@ -429,126 +1651,441 @@ Node parse_block(const std::string &s, size_t &pos) {
     return block;
 }
 
-/**
- * @brief Recursively formats a Node tree into a "box" representation.
- *
- * Each Node becomes a visual ASCII box with borders and optional title.
- *
- * @param node The Node to format.
- * @return std::vector<std::string> The formatted box as a vector of strings.
- */
-std::vector<std::string> format_as_boxes_from_node(const Node &node) {
-    const size_t H_PAD = 3;
-    const size_t V_PAD = 1;
-    const size_t MIN_INNER = 8;
-
-    struct CI {
-        bool is_block;
-        std::vector<std::string> buf;
-        std::string text;
-        size_t w;
-        size_t h;
-    };
-    std::vector<CI> infos;
-    size_t max_child_w = 0;
-    size_t sum_child_h = 0;
+Node parse_block(std::string_view s, size_t &pos) { return parse_block_as<Node>(s, pos, CopyText{}); }
 
-    for (const auto &ch : node.children) {
-        if (ch.is_block) {
-            auto cb = format_as_boxes_from_node(ch);
-            size_t cw = cb.empty() ? 0 : cb[0].size();
-            infos.push_back(CI{true, cb, "", cw, cb.size()});
-            max_child_w = std::max(max_child_w, cw);
-            sum_child_h += cb.size();
+InternedNode parse_block(std::string_view s, size_t &pos, StringInterner &strings) {
+    return parse_block_as<InternedNode>(s, pos, InternText{strings});
+}
+
+Node to_node(const InternedNode &node, const StringInterner &strings) {
+    Node out;
+    out.key = strings.view(node.key);
+    out.value = strings.view(node.value);
+    out.is_block = node.is_block;
+    out.block_type = node.block_type;
+    out.children.reserve(node.children.size());
+    for (const auto &child : node.children)
+        out.children.push_back(to_node(child, strings));
+    return out;
+}
+
+Node parse_block_parallel(std::string_view s, size_t &pos, size_t thread_count, size_t min_chunk_size) {
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    if (thread_count < 2 || pos >= s.size() || (s[pos] != '{' && s[pos] != '(') ||
+        s.size() - pos < 2 * min_chunk_size)
+        return parse_block(s, pos);
+
+    // Pre-scan: track bracket nesting to find the commas between top-level children and the closing bracket of the
+    // block. Only structural characters are visited; the table scan skips everything else.
+    static const Tokenizer structure("{}(),", "");
+    std::vector<char> open_stack;
+    std::vector<size_t> child_starts{pos + 1};
+    size_t end = std::string::npos;
+    for (size_t i = structure.find_delimiter(s, pos); i != std::string::npos; i = structure.find_delimiter(s, i + 1)) {
+        char c = s[i];
+        if (c == '{' || c == '(') {
+            open_stack.push_back(c);
+        } else if (c == ',') {
+            if (open_stack.size() == 1)
+                child_starts.push_back(i + 1);
         } else {
-            std::string text;
-            if (!ch.key.empty()) {
-                if (!ch.value.empty())
-                    text = ch.key + " = " + ch.value;
-                else
-                    text = ch.key;
-            } else {
-                text = ch.value;
+            char expected = (c == '}') ? '{' : '(';
+            if (open_stack.empty() || open_stack.back() != expected)
+                return parse_block(s, pos); // malformed, leave it to the sequential parser
+            open_stack.pop_back();
+            if (open_stack.empty()) {
+                end = i;
+                break;
             }
-            size_t w = text.size();
-            infos.push_back(CI{false, {}, text, w, 1});
-            max_child_w = std::max(max_child_w, w);
-            sum_child_h += 1;
         }
     }
+    if (end == std::string::npos)
+        return parse_block(s, pos); // unterminated
+
+    // group consecutive children into chunks of roughly equal size, at least min_chunk_size bytes each
+    size_t span = end - child_starts.front();
+    size_t chunk_count = std::min(thread_count, std::max<size_t>(1, span / std::max<size_t>(min_chunk_size, 1)));
+    std::vector<size_t> bounds{child_starts.front()};
+    for (size_t k = 1; k < chunk_count; ++k) {
+        size_t target = child_starts.front() + span * k / chunk_count;
+        auto it = std::lower_bound(child_starts.begin(), child_starts.end(), target);
+        if (it != child_starts.end() && *it > bounds.back())
+            bounds.push_back(*it);
+    }
+    bounds.push_back(end);
 
-    size_t title_len = trim(node.key).size();
-    size_t inner_content_width = std::max({MIN_INNER, title_len, max_child_w});
-    inner_content_width += 2 * H_PAD;
+    Node block;
+    block.is_block = true;
+    block.block_type = s[pos];
+    char closing = (block.block_type == '{') ? '}' : ')';
+
+    // each chunk is parsed into its own vector, then the vectors are stitched together in order
+    size_t chunks = bounds.size() - 1;
+    std::vector<std::vector<Node>> parts(chunks);
+    // an exception on any thread is carried back here and rethrown only after every worker has been joined
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    try {
+        for (size_t k = 1; k < chunks; ++k) {
+            workers.emplace_back([&, k] {
+                try {
+                    size_t chunk_pos = bounds[k];
+                    parse_children(s, chunk_pos, bounds[k + 1], closing, parts[k], CopyText{});
+                } catch (...) {
+                    errors[k] = std::current_exception();
+                }
+            });
+        }
+        size_t first_pos = bounds[0];
+        parse_children(s, first_pos, bounds[1], closing, parts[0], CopyText{});
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (auto &worker : workers)
+        worker.join();
+    for (const auto &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    size_t total = 0;
+    for (const auto &part : parts)
+        total += part.size();
+    block.children.reserve(total);
+    for (auto &part : parts)
+        std::move(part.begin(), part.end(), std::back_inserter(block.children));
+
+    pos = end + 1; // consume closing
+    return block;
+}
 
-    size_t width = inner_content_width + 2;
-    size_t n = infos.size();
-    size_t height = 1 + (n + 1) * V_PAD + sum_child_h + 1;
+/// Text shown inside a box for a non-block child.
+std::string box_leaf_text(const Node &node) {
+    if (node.key.empty())
+        return node.value;
+    if (node.value.empty())
+        return node.key;
+    return node.key + " = " + node.value;
+}
 
-    std::vector<std::string> buf(height, std::string(width, ' '));
+/// Line standing in for the @p count children of a box left out by BoxOptions::max_children.
+std::string elided_text(size_t count) { return "... (" + std::to_string(count) + " more)"; }
 
-    // top border with baked-in key
-    if (!node.key.empty()) {
-        std::string decorated = " " + node.key + " ";
-        size_t left_eq = (width > decorated.size()) ? (width - decorated.size()) / 2 : 0;
+std::string format_nested_braces_string_recursive_as_boxes(std::string_view input, const BoxOptions &options) {
+    size_t pos = 0;
+    BoxLineGenerator rows(parse_block(input, pos), options);
+
+    // every row has the same width, so the output can be sized exactly and written row by row
+    std::string out;
+    out.reserve(rows.height() * (rows.width() + 1));
+    std::string row;
+    while (rows.next(row)) {
+        out += row;
+        out += '\n';
+    }
+    return out;
+}
+
+/// Where the next character of a row would go, and which columns of the row are actually kept.
+struct BoxLineGenerator::Cursor {
+    std::string &out;
+    size_t begin; /**< First kept column. */
+    size_t end;   /**< One past the last kept column. */
+    size_t column = 0;
 
-        // fill with '='
-        buf[0].assign(width, '=');
+    bool visible(size_t count) const { return column < end && column + count > begin; }
 
-        // overwrite the middle with the decorated text
-        for (size_t i = 0; i < decorated.size() && left_eq + i < width; ++i) {
-            buf[0][left_eq + i] = decorated[i];
+    void fill(size_t count, char c) {
+        if (visible(count)) {
+            size_t from = std::max(column, begin);
+            size_t to = std::min(column + count, end);
+            out.append(to - from, c);
+        }
+        column += count;
+    }
+
+    void text(std::string_view t) {
+        if (visible(t.size())) {
+            size_t from = std::max(column, begin);
+            size_t to = std::min(column + t.size(), end);
+            out.append(t.substr(from - column, to - from));
+        }
+        column += t.size();
+    }
+};
+
+BoxLineGenerator::BoxLineGenerator(const Node &root, const BoxOptions &options) : root_(&root), options_(options) {
+    measure(*root_, 0, nullptr);
+}
+
+BoxLineGenerator::BoxLineGenerator(Node &&root, const BoxOptions &options)
+    : owned_(std::make_shared<const Node>(std::move(root))), root_(owned_.get()), options_(options) {
+    measure(*root_, 0, nullptr);
+}
+
+BoxLineGenerator::BoxLineGenerator(const Node &root, const BoxOptions &options, size_t depth,
+                                   const RenderChild &render_child)
+    : root_(&root), options_(options), depth_(depth) {
+    measure(*root_, depth_, render_child);
+}
+
+void BoxLineGenerator::set_viewport(const BoxViewport &viewport) {
+    viewport_ = viewport;
+    row_ = viewport.row;
+}
+
+size_t BoxLineGenerator::width() const { return layouts_.at(root_).width; }
+
+size_t BoxLineGenerator::height() const { return layouts_.at(root_).height; }
+
+bool BoxLineGenerator::expanded(const Node &child, size_t depth) const {
+    return child.is_block && depth <= options_.max_depth;
+}
+
+std::string BoxLineGenerator::shorten(std::string text) const {
+    size_t limit = options_.max_text_width;
+    if (text.size() > limit) {
+        if (limit >= 3) {
+            text.resize(limit - 3);
+            text += "...";
+        } else {
+            text.assign(limit, '.');
         }
-    } else {
-        buf[0].assign(width, '=');
     }
+    return text;
+}
 
-    // bottom border
-    buf[height - 1].assign(width, '=');
+std::string BoxLineGenerator::entry_text(const Node &child) const {
+    if (!child.is_block)
+        return shorten(box_leaf_text(child));
+    // a block past max_depth
+    std::string folded = child.block_type == '(' ? "(...)" : "{...}";
+    return shorten(child.key.empty() ? folded : child.key + " " + folded);
+}
 
-    // vertical walls
-    for (size_t r = 1; r + 1 < height; ++r) {
-        buf[r][0] = '|';
-        buf[r][width - 1] = '|';
+void BoxLineGenerator::measure(const Node &node, size_t depth, const RenderChild &render_child) {
+    // only sizes are computed here, nothing is drawn; elided children are not visited at all
+    Layout layout;
+    size_t max_child_w = 0;
+    size_t y = 1 + options_.v_pad;
+
+    layout.shown = std::min(node.children.size(), options_.max_children);
+    for (size_t i = 0; i < layout.shown; ++i) {
+        const Node &ch = node.children[i];
+        size_t w = 0;
+        size_t h = 1;
+        if (expanded(ch, depth + 1) && render_child) {
+            const Box &box = boxes_[&ch] = render_child(ch, depth + 1);
+            w = box->empty() ? 0 : box->front().size();
+            h = box->size();
+            layouts_[&ch] = Layout{w, h, 0, {}};
+        } else if (expanded(ch, depth + 1)) {
+            measure(ch, depth + 1, render_child);
+            const Layout &child = layouts_.at(&ch);
+            w = child.width;
+            h = child.height;
+        } else {
+            w = entry_text(ch).size();
+        }
+        layout.child_y.push_back(y);
+        max_child_w = std::max(max_child_w, w);
+        y += h + options_.v_pad;
+    }
+    if (layout.shown < node.children.size()) {
+        layout.child_y.push_back(y);
+        max_child_w = std::max(max_child_w, elided_text(node.children.size() - layout.shown).size());
+        y += 1 + options_.v_pad;
     }
 
-    // place children, left-justified
-    size_t y = 1 + V_PAD;
-    size_t inner_start = 1 + H_PAD;
-    for (const auto &ci : infos) {
-        size_t x = inner_start;
+    size_t title_len = std::min(trim(node.key).size(), options_.max_text_width);
+    layout.width = std::max({options_.min_inner, title_len, max_child_w}) + 2 * options_.h_pad + 2;
+    layout.height = y + 1;
+    layouts_[&node] = std::move(layout);
+}
 
-        if (ci.is_block) {
-            for (size_t r = 0; r < ci.h; ++r) {
-                const std::string &src = ci.buf[r];
-                for (size_t c = 0; c < src.size() && x + c < width - 1; ++c) {
-                    if (y + r < height - 1)
-                        buf[y + r][x + c] = src[c];
-                }
+void BoxLineGenerator::write_row(const Node &node, size_t row, size_t depth, Cursor &cursor) const {
+    const Layout &layout = layouts_.at(&node);
+    size_t width = layout.width;
+
+    if (!cursor.visible(width)) {
+        cursor.column += width;
+        return;
+    }
+    if (!boxes_.empty()) {
+        if (auto it = boxes_.find(&node); it != boxes_.end()) {
+            cursor.text((*it->second)[row]);
+            return;
+        }
+    }
+
+    if (row == 0) {
+        if (node.key.empty()) {
+            cursor.fill(width, '=');
+            return;
+        }
+        std::string decorated = " " + shorten(node.key) + " ";
+        size_t left_eq = (width > decorated.size()) ? (width - decorated.size()) / 2 : 0;
+        size_t shown = std::min(decorated.size(), width - left_eq);
+        cursor.fill(left_eq, '=');
+        cursor.text(std::string_view(decorated).substr(0, shown));
+        cursor.fill(width - left_eq - shown, '=');
+        return;
+    }
+    if (row + 1 == layout.height) {
+        cursor.fill(width, '=');
+        return;
+    }
+
+    size_t start = cursor.column;
+    cursor.fill(1, '|');
+
+    // the last child starting at or above this row is the only one that can cover it
+    auto it = std::upper_bound(layout.child_y.begin(), layout.child_y.end(), row);
+    if (it != layout.child_y.begin()) {
+        size_t i = static_cast<size_t>(it - layout.child_y.begin()) - 1;
+        size_t child_row = row - layout.child_y[i];
+
+        if (i == layout.shown) {
+            if (child_row == 0) {
+                cursor.fill(options_.h_pad, ' ');
+                cursor.text(elided_text(node.children.size() - layout.shown));
             }
         } else {
-            for (size_t c = 0; c < ci.text.size() && x + c < width - 1; ++c) {
-                if (y < height - 1)
-                    buf[y][x + c] = ci.text[c];
+            const Node &child = node.children[i];
+            if (expanded(child, depth + 1)) {
+                if (child_row < layouts_.at(&child).height) {
+                    cursor.fill(options_.h_pad, ' ');
+                    write_row(child, child_row, depth + 1, cursor);
+                }
+            } else if (child_row == 0) {
+                cursor.fill(options_.h_pad, ' ');
+                if (cursor.column < cursor.end)
+                    cursor.text(entry_text(child));
             }
         }
+    }
+
+    cursor.fill(start + width - 1 - cursor.column, ' ');
+    cursor.fill(1, '|');
+}
 
-        y += ci.h;
-        y += V_PAD;
+bool BoxLineGenerator::next(std::string &line) {
+    size_t last = height();
+    if (viewport_.height < last - std::min(viewport_.row, last))
+        last = viewport_.row + viewport_.height;
+    if (row_ >= last)
+        return false;
+
+    line.clear();
+    size_t end = viewport_.width < width() - std::min(viewport_.column, width()) ? viewport_.column + viewport_.width
+                                                                                    : width();
+    Cursor cursor{line, viewport_.column, end};
+    write_row(*root_, row_++, depth_, cursor);
+    return true;
+}
+
+BoxRenderCache::Fingerprint BoxRenderCache::fingerprint(const Node &node, Fingerprints &out) {
+    // a is FNV-1a, b an independent multiply-rotate hash, both over the same length-prefixed byte stream
+    Fingerprint f{0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+    auto feed_byte = [&](unsigned char c) {
+        f.a = (f.a ^ c) * 0x100000001b3ULL;
+        f.b = ((f.b << 5) | (f.b >> 59)) ^ c;
+        f.b *= 0xff51afd7ed558ccdULL;
+    };
+    auto feed_u64 = [&](uint64_t v) {
+        for (int i = 0; i < 8; ++i)
+            feed_byte(static_cast<unsigned char>(v >> (8 * i)));
+    };
+    auto feed_string = [&](const std::string &str) {
+        feed_u64(str.size());
+        for (char c : str)
+            feed_byte(static_cast<unsigned char>(c));
+    };
+
+    feed_byte(node.is_block ? 1 : 0);
+    feed_byte(static_cast<unsigned char>(node.block_type));
+    feed_string(node.key);
+    feed_string(node.value);
+    feed_u64(node.children.size());
+    for (const auto &ch : node.children) {
+        Fingerprint cf = fingerprint(ch, out);
+        feed_u64(cf.a);
+        feed_u64(cf.b);
     }
 
-    return buf;
+    if (node.is_block)
+        out[&node] = f;
+    return f;
 }
 
-std::string format_nested_braces_string_recursive_as_boxes(const std::string &input) {
+BoxRenderCache::Box BoxRenderCache::render_node(const Node &node, size_t depth, const Fingerprints &fingerprints) {
+    Fingerprint fp = fingerprints.at(&node);
+    if (options_.max_depth != std::string::npos)
+        fp.depth = depth;
+
+    if (auto it = index_.find(fp); it != index_.end()) {
+        ++hits_;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->box;
+    }
+
+    ++misses_;
+    BoxLineGenerator rows(node, options_, depth, [&](const Node &child, size_t child_depth) {
+        return render_node(child, child_depth, fingerprints);
+    });
+    std::vector<std::string> lines;
+    lines.reserve(rows.height());
+    for (std::string row; rows.next(row);)
+        lines.push_back(row);
+    Box box = std::make_shared<const std::vector<std::string>>(std::move(lines));
+
+    if (capacity_ == 0)
+        return box;
+
+    if (auto it = index_.find(fp); it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front(Entry{fp, box});
+    index_[fp] = lru_.begin();
+
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().fingerprint);
+        lru_.pop_back();
+    }
+
+    return box;
+}
+
+std::vector<std::string> BoxRenderCache::render_lines(const Node &root) {
+    if (!root.is_block) {
+        std::vector<std::string> lines;
+        BoxLineGenerator rows(root, options_);
+        for (std::string row; rows.next(row);)
+            lines.push_back(row);
+        return lines;
+    }
+    Fingerprints fingerprints;
+    fingerprint(root, fingerprints);
+    return *render_node(root, 0, fingerprints);
+}
+
+std::string BoxRenderCache::render(const Node &root) {
+    std::vector<std::string> lines = render_lines(root);
+    std::string out;
+    out.reserve(lines.empty() ? 0 : lines.size() * (lines.front().size() + 1));
+    for (const auto &l : lines) {
+        out += l;
+        out += '\n';
+    }
+    return out;
+}
+
+std::string BoxRenderCache::render(std::string_view input) {
     size_t pos = 0;
     Node root = parse_block(input, pos);
-    auto buf = format_as_boxes_from_node(root);
-
-    std::ostringstream out;
-    for (auto &l : buf)
-        out << l << "\n";
-    return out.str();
+    return render(root);
 }
 
 /**
@@ -561,59 +2098,246 @@ std::string indent_str(int level) {
     return std::string(level * 2, ' '); // 2 spaces per level
 }
 
-/**
- * @brief Formats a Node tree into a human-readable string with newlines and indentation.
- *
- * Each block and key-value pair is placed on its own line, with indentation representing nesting.
- *
- * @param node The Node to format.
- * @param indent Current indentation level (default 0).
- * @return std::string The formatted string with newlines.
- */
-std::string format_with_newlines_from_node(const Node &node, int indent) {
-    std::string ind = indent_str(indent);
-    std::string result;
+NewlineLineGenerator::NewlineLineGenerator(const Node &root) { stack_.push_back(Frame{&root, 0, true}); }
 
-    if (node.is_block) {
-        char open_brace = node.block_type;
-        char close_brace = (open_brace == '{') ? '}' : ')';
+NewlineLineGenerator::NewlineLineGenerator(Node &&root) : owned_(std::make_shared<const Node>(std::move(root))) {
+    stack_.push_back(Frame{owned_.get(), 0, true});
+}
 
-        if (!node.key.empty())
-            result += ind + node.key + " = ";
+bool NewlineLineGenerator::next(std::string &line) {
+    // Each block with children spans an opening line, its children's lines and a closing line; every node's final
+    // line carries the comma separating it from its next sibling.
+    while (!stack_.empty()) {
+        Frame &frame = stack_.back();
+        const Node &node = *frame.node;
+        std::string ind = indent_str(frame.indent);
+        const char *trailing_comma = frame.last_in_parent ? "" : ",";
+
+        if (!frame.opened) {
+            frame.opened = true;
+            line.clear();
+
+            if (!node.is_block) {
+                line += ind;
+                if (!node.key.empty())
+                    line += node.key + " = ";
+                line += node.value;
+                line += trailing_comma;
+                stack_.pop_back();
+                return true;
+            }
 
-        result += open_brace;
-        if (!node.children.empty())
-            result += "\n";
+            if (!node.key.empty())
+                line += ind + node.key + " = ";
+            line += node.block_type;
+            if (node.children.empty()) {
+                line += (node.block_type == '{') ? '}' : ')';
+                line += trailing_comma;
+                stack_.pop_back();
+            }
+            return true;
+        }
 
-        for (size_t i = 0; i < node.children.size(); ++i) {
-            result += format_with_newlines_from_node(node.children[i], indent + 1);
-            if (i + 1 < node.children.size())
-                result += ",\n";
-            else
-                result += "\n";
+        if (frame.next_child < node.children.size()) {
+            size_t i = frame.next_child++;
+            int indent = frame.indent + 1;
+            bool last = i + 1 == node.children.size();
+            stack_.push_back(Frame{&node.children[i], indent, last}); // invalidates frame
+            continue;
         }
 
-        if (!node.children.empty())
-            result += ind;
-        result += close_brace;
-    } else {
-        if (!node.key.empty())
-            result += ind + node.key + " = ";
+        line = ind;
+        line += (node.block_type == '{') ? '}' : ')';
+        line += trailing_comma;
+        stack_.pop_back();
+        return true;
+    }
+    return false;
+}
+
+std::string format_nested_braces_string_recursive_with_newlines(std::string_view input) {
+    size_t pos = 0;
+    NewlineLineGenerator lines(parse_block(input, pos));
+
+    std::string out;
+    std::string line;
+    while (lines.next(line)) {
+        out += line;
+        out += '\n';
+    }
+    return out;
+}
+
+NodePathIndex::NodePathIndex(const Node &root) : root_(&root) {
+    std::string path;
+    build(root, path);
+    std::sort(sorted_.begin(), sorted_.end());
+    index_paths();
+}
+
+NodePathIndex::NodePathIndex(const NodePathIndex &other)
+    : root_(other.root_), sorted_(other.sorted_), position_(other.position_) {
+    index_paths();
+}
+
+NodePathIndex &NodePathIndex::operator=(const NodePathIndex &other) {
+    if (this != &other) {
+        root_ = other.root_;
+        sorted_ = other.sorted_;
+        position_ = other.position_;
+        index_paths();
+    }
+    return *this;
+}
+
+void NodePathIndex::index_paths() {
+    by_path_.clear();
+    by_path_.reserve(sorted_.size());
+    for (const auto &[path, node] : sorted_)
+        by_path_.emplace(path, node);
+}
+
+std::string NodePathIndex::escape_segment(std::string_view key) {
+    std::string out;
+    out.reserve(key.size() + 1);
+    if (!key.empty() && std::all_of(key.begin(), key.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        out += '\\'; // not a position
+    for (char c : key) {
+        if (c == '.' || c == '/' || c == '*' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+std::vector<std::string> NodePathIndex::child_segments(const Node &parent) {
+    std::vector<std::string> segments;
+    segments.reserve(parent.children.size());
+    std::unordered_set<std::string_view> seen_keys;
+    for (size_t i = 0; i < parent.children.size(); ++i) {
+        const std::string &key = parent.children[i].key;
+        // later siblings with an already used key fall back to their position, so no subtree becomes unreachable
+        if (!key.empty() && seen_keys.insert(key).second)
+            segments.push_back(escape_segment(key));
         else
-            result += ind;
-        result += node.value;
+            segments.push_back(std::to_string(i));
     }
+    return segments;
+}
 
-    return result;
+std::vector<std::string> NodePathIndex::split_path(std::string_view path) {
+    std::vector<std::string> segments;
+    if (path.empty())
+        return segments;
+
+    // separators are unescaped '.' and '/'; escapes are kept, since stored segments are escaped too
+    std::string current;
+    for (size_t i = 0; i < path.size(); ++i) {
+        char c = path[i];
+        if (c == '\\' && i + 1 < path.size()) {
+            current += c;
+            current += path[++i];
+        } else if (c == '.' || c == '/') {
+            segments.push_back(std::move(current));
+            current.clear();
+        } else {
+            current += c;
+        }
+    }
+    segments.push_back(std::move(current));
+    return segments;
 }
 
-std::string format_nested_braces_string_recursive_with_newlines(const std::string &input) {
-    size_t pos = 0;
-    Node root = parse_block(input, pos);
+std::string NodePathIndex::canonical(std::string_view path) { return join(split_path(path), "."); }
+
+void NodePathIndex::build(const Node &node, std::string &path) {
+    position_.emplace(&node, sorted_.size());
+    sorted_.emplace_back(path, &node);
+
+    std::vector<std::string> segments = child_segments(node);
+    size_t length = path.size();
+    for (size_t i = 0; i < node.children.size(); ++i) {
+        if (length > 0)
+            path += '.';
+        path += segments[i];
+        build(node.children[i], path);
+        path.resize(length);
+    }
+}
 
-    std::ostringstream out;
-    out << format_with_newlines_from_node(root, 0) << "\n"; // call the original function
-    return out.str();
+const Node *NodePathIndex::find(std::string_view path) const {
+    // without '/' a path is already canonical, and can be looked up as is
+    auto it = path.find('/') == std::string_view::npos ? by_path_.find(path) : by_path_.find(canonical(path));
+    return it == by_path_.end() ? nullptr : it->second;
+}
+
+std::vector<NodePathIndex::Match> NodePathIndex::with_prefix(std::string_view prefix) const {
+    std::string base = canonical(prefix);
+    std::vector<Match> out;
+
+    if (base.empty())
+        return sorted_;
+
+    // the node itself, then its descendants, which all start with "base." and so are contiguous when sorted
+    if (const Node *node = find(base))
+        out.emplace_back(base, node);
+    std::string lower = base + '.';
+    auto first = std::lower_bound(sorted_.begin(), sorted_.end(), lower,
+                                  [](const Match &m, const std::string &key) { return m.first < key; });
+    for (auto it = first; it != sorted_.end() && starts_with(it->first, lower); ++it)
+        out.push_back(*it);
+    return out;
+}
+
+std::vector<NodePathIndex::Match> NodePathIndex::match(std::string_view pattern) const {
+    std::vector<std::string> segments = split_path(pattern);
+
+    std::vector<Match> out;
+    std::string path;
+    match_from(*root_, path, segments, 0, out);
+
+    // "**" can reach the same node along several expansions, and its zero-segment expansion reaches a node's own
+    // children before the subtrees of their earlier siblings; keep one occurrence of each and sort by position
+    std::unordered_set<const Node *> seen;
+    out.erase(std::remove_if(out.begin(), out.end(), [&](const Match &m) { return !seen.insert(m.second).second; }),
+              out.end());
+    std::sort(out.begin(), out.end(),
+              [&](const Match &a, const Match &b) { return position_.at(a.second) < position_.at(b.second); });
+    return out;
+}
+
+void NodePathIndex::match_from(const Node &node, std::string &path, const std::vector<std::string> &segments,
+                               size_t next, std::vector<Match> &out) const {
+    if (next == segments.size()) {
+        out.emplace_back(path, &node);
+        return;
+    }
+
+    const std::string &seg = segments[next];
+    size_t length = path.size();
+
+    if (seg == "*" || seg == "**") {
+        if (seg == "**")
+            match_from(node, path, segments, next + 1, out); // zero segments
+        std::vector<std::string> children = child_segments(node);
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            if (length > 0)
+                path += '.';
+            path += children[i];
+            // "*" consumes the segment, "**" stays active for one more
+            match_from(node.children[i], path, segments, seg == "**" ? next : next + 1, out);
+            path.resize(length);
+        }
+    } else {
+        // literal segment: a single hash lookup instead of scanning the children
+        std::string child_path = length > 0 ? path + '.' + seg : seg;
+        auto it = by_path_.find(child_path);
+        if (it != by_path_.end()) {
+            path = child_path;
+            match_from(*it->second, path, segments, next + 1, out);
+            path.resize(length);
+        }
+    }
 }
 
 } // namespace text_utils
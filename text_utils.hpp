@@ -1,11 +1,23 @@
 #ifndef TEXT_UTILS_HPP
 #define TEXT_UTILS_HPP
 
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace text_utils {
 
@@ -78,6 +90,123 @@ class StringAccumulator {
     std::string data_;
 };
 
+/**
+ * @class ConcurrentStringAccumulator
+ * @brief A StringAccumulator that many threads can append to at once without locking.
+ *
+ * Each thread appends into its own buffer, registered under a lock on that thread's first append; after that the
+ * append path touches no shared state apart from an optional sequence counter. Buffers fill fixed-size segments, and
+ * full segments (or ones handed off early with flush()) go through a lock-free list so a writer thread can drain them
+ * with drain_segments() while producers keep appending.
+ *
+ * str(), drain(), size() and clear() look at the partially filled segments too, so they must only be called once
+ * producers are quiescent (e.g. after joining them).
+ */
+class ConcurrentStringAccumulator {
+  public:
+    /// How fragments from different threads are ordered when the buffers are merged.
+    enum class Order {
+        per_thread, /**< All of one thread's fragments, then the next thread's, in first-append order. */
+        sequence,   /**< Global order in which add() was called, tracked with one atomic counter. */
+    };
+
+    /**
+     * @param order How str() and drain() merge the per-thread buffers.
+     * @param segment_size Bytes a segment holds before it is handed off to drain_segments().
+     */
+    explicit ConcurrentStringAccumulator(Order order = Order::per_thread, size_t segment_size = 64 * 1024);
+    ~ConcurrentStringAccumulator();
+
+    ConcurrentStringAccumulator(const ConcurrentStringAccumulator &) = delete;
+    ConcurrentStringAccumulator &operator=(const ConcurrentStringAccumulator &) = delete;
+
+    /**
+     * @brief Append values to the calling thread's buffer.
+     *
+     * The values of one call are kept together as a single fragment.
+     *
+     * @tparam Args Any streamable types.
+     * @param args Values to append.
+     */
+    template <typename... Args> void add(Args &&...args) {
+        std::ostringstream oss;
+        (oss << ... << args); // fold expression to stream all args
+        append(oss.str());
+    }
+
+    /// Append a single fragment to the calling thread's buffer.
+    void append(std::string_view fragment);
+
+    /// Hand off the calling thread's partially filled segment, so the next drain_segments() sees all of its text.
+    void flush();
+
+    /**
+     * @brief Take every segment handed off so far; safe to call while producers are appending.
+     *
+     * The returned strings, concatenated, are the drained text. With Order::per_thread they are the segments, those of
+     * one thread in that thread's order and threads in first-append order. With Order::sequence the fragments of all
+     * drained segments are merged by sequence number into a single string; a fragment still sitting in a segment that
+     * was not handed off can therefore come out in a later drain than fragments added after it.
+     */
+    std::vector<std::string> drain_segments();
+
+    /// Merge all buffers into one string. Producers must be quiescent.
+    std::string str() const;
+
+    /// Merge all buffers into one string and clear them. Producers must be quiescent.
+    std::string drain();
+
+    /// Discard all buffered text. Producers must be quiescent.
+    void clear();
+
+    /// Total number of buffered bytes. Producers must be quiescent.
+    size_t size() const;
+
+  private:
+    struct Segment {
+        std::string data;
+        /// (sequence number, end offset) of every fragment, only recorded for Order::sequence.
+        std::vector<std::pair<uint64_t, size_t>> marks;
+        Segment *next = nullptr;
+    };
+
+    struct ThreadBuffers;
+
+    struct Buffer {
+        Segment *current = nullptr;                /**< Only touched by the owning thread. */
+        std::atomic<Segment *> published{nullptr}; /**< Handed-off segments, newest first. */
+        Buffer *next = nullptr;
+        ThreadBuffers *owner = nullptr; /**< The owning thread's map of buffers, null once that thread has exited. */
+    };
+
+    Buffer &local_buffer();
+    static void publish(Buffer &buffer);
+    std::vector<Buffer *> buffers_in_order() const;
+    std::vector<const Segment *> segments_in_order(const Buffer &buffer) const;
+    static void merge_by_sequence(const std::vector<std::vector<const Segment *>> &per_thread, std::string &out);
+
+    uint64_t id_;
+    Order order_;
+    size_t segment_size_;
+    std::atomic<Buffer *> buffers_{nullptr}; /**< Registered buffers, newest first. */
+    std::atomic<uint64_t> next_sequence_{0};
+};
+
+/**
+ * @class MultilineStringAccumulator
+ * @brief Accumulates indented lines of text, supporting cheap edits at arbitrary positions.
+ *
+ * Lines are stored in a persistent rope (a randomized binary tree whose nodes are immutable and shared), so
+ * inserting, removing and splicing lines anywhere costs O(log n) expected instead of moving every following line.
+ * Splicing another accumulator shares its nodes rather than copying its lines, and copying an accumulator is O(1) plus
+ * O(k) for the k lines appended since its last edit.
+ *
+ * Indentation is deferred: each line records its level and a subtree can carry extra levels for all of its lines,
+ * so nesting a whole accumulator one level deeper is O(1). Spaces are only produced by str().
+ *
+ * Appended lines are first collected in a plain tail vector and only built into the rope, in O(k), by the next
+ * edit, so appending costs the same as pushing onto a vector.
+ */
 class MultilineStringAccumulator {
   public:
     MultilineStringAccumulator() : indent_level_(0), indent_size_(4) {}
@@ -99,22 +228,15 @@ class MultilineStringAccumulator {
      */
     template <typename... Args> void add(Args &&...args) {
         std::ostringstream oss;
-        oss << std::string(indent_level_ * indent_size_, ' '); // indent prefix
-        (oss << ... << args);                                  // fold expression (C++17+)
-        lines_.emplace_back(oss.str());
+        (oss << ... << args); // fold expression (C++17+)
+        tail_.emplace_back(oss.str(), indent_level_);
     }
 
     /**
      * @brief Add multiple lines with indentation applied.
      * @param multiline_str Input string with newlines.
      */
-    void add_multiline(const std::string &multiline_str) {
-        std::istringstream iss(multiline_str);
-        std::string line;
-        while (std::getline(iss, line)) {
-            lines_.emplace_back(std::string(indent_level_ * indent_size_, ' ') + line);
-        }
-    }
+    void add_multiline(std::string_view multiline_str) { split_lines(multiline_str, tail_); }
 
     /**
      * @brief Insert a line at the given index.
@@ -122,24 +244,36 @@ class MultilineStringAccumulator {
      * @param line Text to insert.
      * @throws std::out_of_range if index is invalid.
      */
-    void insert_line(size_t index, const std::string &line) {
-        if (index > lines_.size()) {
+    void insert_line(size_t index, std::string_view line) {
+        if (index > line_count()) {
             throw std::out_of_range("insert_line: index out of range");
         }
-        lines_.insert(lines_.begin() + index, std::string(indent_level_ * indent_size_, ' ') + line);
+        flush();
+        splice(index, make_leaf(std::string(line)));
     }
 
     /**
-     * @brief Insert all lines from another accumulator.
+     * @brief Insert all lines from another accumulator, nested at the current indentation level.
+     *
+     * The lines keep their indentation relative to @p other and share storage with it; neither accumulator
+     * observes later edits to the other. @p other is only read, so several threads may splice the same one at once.
+     * Nesting costs O(log n) plus O(k) for the k lines appended to @p other since its last edit.
+     *
      * @param index Position in the list of lines.
      * @param other Another accumulator containing lines.
      * @throws std::out_of_range if index is invalid.
      */
     void insert_lines(size_t index, const MultilineStringAccumulator &other) {
-        if (index > lines_.size()) {
+        if (index > line_count()) {
             throw std::out_of_range("insert_lines: index out of range");
         }
-        lines_.insert(lines_.begin() + index, other.lines_.begin(), other.lines_.end());
+        flush();
+        LinePtr lines = other.root_;
+        if (!other.tail_.empty()) {
+            std::vector<TailLine> tail = other.tail_;
+            lines = merge(lines, build_balanced(tail, 0, tail.size()));
+        }
+        splice(index, shifted(lines, indent_level_));
     }
 
     /**
@@ -148,20 +282,12 @@ class MultilineStringAccumulator {
      * @param multiline_str String containing newlines.
      * @throws std::out_of_range if index is invalid.
      */
-    void insert_multiline(size_t index, const std::string &multiline_str) {
-        if (index > lines_.size()) {
+    void insert_multiline(size_t index, std::string_view multiline_str) {
+        if (index > line_count()) {
             throw std::out_of_range("insert_multiline: index out of range");
         }
-
-        std::istringstream iss(multiline_str);
-        std::string line;
-        std::vector<std::string> new_lines;
-
-        while (std::getline(iss, line)) {
-            new_lines.emplace_back(std::string(indent_level_ * indent_size_, ' ') + line);
-        }
-
-        lines_.insert(lines_.begin() + index, new_lines.begin(), new_lines.end());
+        flush();
+        splice(index, build_lines(multiline_str));
     }
 
     /**
@@ -170,37 +296,228 @@ class MultilineStringAccumulator {
      * @throws std::out_of_range if index is invalid.
      */
     void remove_line(size_t index) {
-        if (index >= lines_.size()) {
+        if (index >= line_count()) {
             throw std::out_of_range("remove_line: index out of range");
         }
-        lines_.erase(lines_.begin() + index);
+        flush();
+        auto [before, rest] = split(root_, index);
+        root_ = merge(before, split(rest, 1).second);
     }
 
     /// Get the accumulated text as a single string with newlines.
     std::string str() const {
-        std::ostringstream oss;
-        for (size_t i = 0; i < lines_.size(); ++i) {
-            oss << lines_[i];
-            if (i + 1 < lines_.size()) {
-                oss << '\n';
+        std::string out;
+        if (line_count() == 0) {
+            return out;
+        }
+        size_t reserve = bytes(root_) + level_sum(root_) * indent_size_ + line_count() - 1;
+        for (const auto &[line, level] : tail_)
+            reserve += line.size() + level * indent_size_;
+        out.reserve(reserve);
+
+        // iterative in-order walk carrying the levels added by ancestors, the rope is only O(log n) deep
+        std::vector<std::pair<const LineNode *, size_t>> stack;
+        const LineNode *node = root_.get();
+        size_t outer = 0;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.emplace_back(node, outer);
+                outer += node->shift;
+                node = node->left.get();
             }
+            auto [visited, visited_outer] = stack.back();
+            stack.pop_back();
+            size_t inner = visited_outer + visited->shift;
+            out.append((inner + visited->level) * indent_size_, ' ');
+            out += visited->line;
+            out += '\n';
+            node = visited->right.get();
+            outer = inner;
         }
-        return oss.str();
+        for (const auto &[line, level] : tail_) {
+            out.append(level * indent_size_, ' ');
+            out += line;
+            out += '\n';
+        }
+        out.pop_back(); // no trailing newline
+        return out;
     }
 
     /// Clear all stored lines.
-    void clear() { lines_.clear(); }
+    void clear() {
+        root_.reset();
+        tail_.clear();
+    }
 
     /// Get the number of stored lines.
-    size_t line_count() const { return lines_.size(); }
+    size_t line_count() const { return count(root_) + tail_.size(); }
 
   private:
-    std::vector<std::string> lines_;
+    friend struct MultilineStringAccumulatorInspector; // defined by the tests to look at the rope's shape
+
+    struct LineNode;
+    using LinePtr = std::shared_ptr<const LineNode>;
+    using TailLine = std::pair<std::string, size_t>; /**< Text and indentation level of an appended line. */
+
+    /// Immutable rope node; @ref count, @ref bytes and @ref level_sum summarise the whole subtree.
+    struct LineNode {
+        LinePtr left;
+        LinePtr right;
+        std::string line;     /**< Text of the line, without indentation. */
+        size_t level = 0;     /**< Indentation level of this line, before @ref shift. */
+        size_t shift = 0;     /**< Levels added to every line in this subtree. */
+        size_t count = 1;
+        size_t bytes = 0;     /**< Text bytes in the subtree, without indentation. */
+        size_t level_sum = 0; /**< Sum of the levels of every line in the subtree, @ref shift included. */
+    };
+
+    static size_t count(const LinePtr &node) { return node ? node->count : 0; }
+    static size_t bytes(const LinePtr &node) { return node ? node->bytes : 0; }
+    static size_t level_sum(const LinePtr &node) { return node ? node->level_sum : 0; }
+
+    uint64_t next_random() {
+        // xorshift64, only has to be well spread, not unpredictable
+        rng_state_ ^= rng_state_ << 13;
+        rng_state_ ^= rng_state_ >> 7;
+        rng_state_ ^= rng_state_ << 17;
+        return rng_state_;
+    }
+
+    /// A single line at the current indentation level.
+    LinePtr make_leaf(std::string line) {
+        auto node = std::make_shared<LineNode>();
+        node->bytes = line.size();
+        node->line = std::move(line);
+        node->level = indent_level_;
+        node->level_sum = indent_level_;
+        return node;
+    }
+
+    /// The same subtree with every line @p levels deeper; copies only the root node.
+    static LinePtr shifted(const LinePtr &node, size_t levels) {
+        if (!node || levels == 0) {
+            return node;
+        }
+        auto copy = std::make_shared<LineNode>(*node);
+        copy->shift += levels;
+        copy->level_sum += levels * copy->count;
+        return copy;
+    }
+
+    /// Copy a node on the path of an edit with @p level as its final level, keeping its line.
+    static LinePtr with_children(const LineNode &node, size_t level, LinePtr left, LinePtr right) {
+        auto copy = std::make_shared<LineNode>();
+        copy->count = 1 + count(left) + count(right);
+        copy->bytes = node.line.size() + bytes(left) + bytes(right);
+        copy->level_sum = level + level_sum(left) + level_sum(right);
+        copy->left = std::move(left);
+        copy->right = std::move(right);
+        copy->line = node.line;
+        copy->level = level;
+        return copy;
+    }
+
+    /// Split into the first @p k lines and the rest.
+    static std::pair<LinePtr, LinePtr> split(const LinePtr &node, size_t k) {
+        if (!node) {
+            return {nullptr, nullptr};
+        }
+        // push the node's shift down to its children before they are detached from it
+        LinePtr left = shifted(node->left, node->shift);
+        LinePtr right = shifted(node->right, node->shift);
+        size_t level = node->level + node->shift;
+        if (count(left) >= k) {
+            auto [l, r] = split(left, k);
+            return {l, with_children(*node, level, r, right)};
+        }
+        auto [l, r] = split(right, k - count(left) - 1);
+        return {with_children(*node, level, left, l), r};
+    }
+
+    /**
+     * @brief Concatenate two ropes, every line of @p a preceding every line of @p b.
+     *
+     * The root is picked at random with probability proportional to subtree size. Nodes are shared between ropes,
+     * so a priority stored in them would repeat whenever the same subtree is spliced in twice and the tree would
+     * degenerate; a fresh draw per merge keeps it a random binary search tree, O(log n) deep in expectation.
+     */
+    LinePtr merge(const LinePtr &a, const LinePtr &b) {
+        if (!a) {
+            return b;
+        }
+        if (!b) {
+            return a;
+        }
+        if (next_random() % (a->count + b->count) < a->count) {
+            return with_children(*a, a->level + a->shift, shifted(a->left, a->shift),
+                                 merge(shifted(a->right, a->shift), b));
+        }
+        return with_children(*b, b->level + b->shift, merge(a, shifted(b->left, b->shift)),
+                             shifted(b->right, b->shift));
+    }
+
+    void splice(size_t index, const LinePtr &lines) {
+        auto [before, after] = split(root_, index);
+        root_ = merge(merge(before, lines), after);
+    }
+
+    /// Move the tail into the rope.
+    void flush() {
+        if (!tail_.empty()) {
+            root_ = merge(root_, build_balanced(tail_, 0, tail_.size()));
+            tail_.clear();
+        }
+    }
+
+    /// Append the lines of @p multiline_str to @p out at the current indentation level.
+    void split_lines(std::string_view multiline_str, std::vector<TailLine> &out) const {
+        // same lines as std::getline: a trailing newline does not start another line
+        size_t pos = 0;
+        while (pos < multiline_str.size()) {
+            size_t end = multiline_str.find('\n', pos);
+            if (end == std::string_view::npos)
+                end = multiline_str.size();
+            out.emplace_back(multiline_str.substr(pos, end - pos), indent_level_);
+            pos = end + 1;
+        }
+    }
+
+    /// Build a rope from the lines of @p multiline_str in O(k), at the current indentation level.
+    LinePtr build_lines(std::string_view multiline_str) const {
+        std::vector<TailLine> lines;
+        split_lines(multiline_str, lines);
+        return build_balanced(lines, 0, lines.size());
+    }
+
+    /// A perfectly balanced rope of lines [@p first, @p last), moved out of @p lines.
+    static LinePtr build_balanced(std::vector<TailLine> &lines, size_t first, size_t last) {
+        if (first == last) {
+            return nullptr;
+        }
+        size_t mid = first + (last - first) / 2;
+        auto node = std::make_shared<LineNode>();
+        node->left = build_balanced(lines, first, mid);
+        node->right = build_balanced(lines, mid + 1, last);
+        node->line = std::move(lines[mid].first);
+        node->level = lines[mid].second;
+        node->count = last - first;
+        node->bytes = node->line.size() + bytes(node->left) + bytes(node->right);
+        node->level_sum = node->level + level_sum(node->left) + level_sum(node->right);
+        return node;
+    }
+
+    LinePtr root_;
+    std::vector<TailLine> tail_;
+    uint64_t rng_state_ = 0x9e3779b97f4a7c15ULL;
     size_t indent_level_;
     size_t indent_size_;
 };
 
 // ---------------- Free functions ----------------
+//
+// Read-only string inputs are taken as std::string_view, so literals and substrings are not copied. Code that stored
+// these functions in pointers typed on `const std::string&`, or passed a type that only converts to std::string (such
+// as std::filesystem::path), has to wrap the call or convert with .string() first.
 
 /**
  * @brief Remove consecutive duplicate characters from a string.
@@ -208,20 +525,20 @@ class MultilineStringAccumulator {
  * @param dedup_chars Characters to deduplicate (empty = all).
  * @return String with duplicates removed.
  */
-std::string remove_consecutive_duplicates(const std::string &input, const std::string &dedup_chars = "");
+std::string remove_consecutive_duplicates(std::string_view input, std::string_view dedup_chars = "");
 
 /**
  * @brief Abbreviate a snake_case string by shortening each word.
  * @param input Input snake_case string.
  * @return Abbreviated string.
  */
-std::string abbreviate_snake_case(const std::string &input);
+std::string abbreviate_snake_case(std::string_view input);
 
 /// Check if a string represents an integer.
-bool is_integer(const std::string &str);
+bool is_integer(std::string_view str);
 
 /// Check if a string represents a rational (floating-point) number.
-bool is_rational(const std::string &str);
+bool is_rational(std::string_view str);
 
 /**
  * @brief Insert newlines into long strings.
@@ -229,7 +546,7 @@ bool is_rational(const std::string &str);
  * @param max_chars_per_line Maximum characters per line.
  * @return String with line breaks inserted.
  */
-std::string add_newlines_to_long_string(const std::string &text, size_t max_chars_per_line = 25);
+std::string add_newlines_to_long_string(std::string_view text, size_t max_chars_per_line = 25);
 
 /**
  * @brief Split a string by a delimiter.
@@ -237,7 +554,7 @@ std::string add_newlines_to_long_string(const std::string &text, size_t max_char
  * @param delimiter Delimiter string.
  * @return Vector of substrings.
  */
-std::vector<std::string> split(const std::string &str, const std::string &delimiter);
+std::vector<std::string> split(std::string_view str, std::string_view delimiter);
 
 /**
  * @brief Split a string once from the right.
@@ -245,7 +562,20 @@ std::vector<std::string> split(const std::string &str, const std::string &delimi
  * @param delimiter Delimiter string.
  * @return Vector with up to two substrings.
  */
-std::vector<std::string> split_once_from_right(const std::string &str, const std::string &delimiter);
+std::vector<std::string> split_once_from_right(std::string_view str, std::string_view delimiter);
+
+/// Like split_once_from_right, but without allocating: the part before the last @p delimiter and the part after it,
+/// both views into @p str. Without a delimiter the first is all of @p str and the second is std::nullopt.
+std::pair<std::string_view, std::optional<std::string_view>> split_once_from_right_view(std::string_view str,
+                                                                                        std::string_view delimiter);
+
+/**
+ * @brief Split a string at every occurrence of any of the given characters.
+ * @param str Input string.
+ * @param delimiter_chars Characters to split on.
+ * @return Vector of substrings, including empty ones between adjacent delimiters.
+ */
+std::vector<std::string> split_on_any_of(std::string_view str, std::string_view delimiter_chars);
 
 /**
  * @brief Join elements into a single string with a separator.
@@ -253,10 +583,109 @@ std::vector<std::string> split_once_from_right(const std::string &str, const std
  * @param separator Separator string.
  * @return Concatenated string.
  */
-std::string join(const std::vector<std::string> &elements, const std::string &separator);
+std::string join(const std::vector<std::string> &elements, std::string_view separator);
+
+namespace detail {
+
+/// Hand the text of one join element to @p write; numbers are formatted with std::to_chars into a stack buffer.
+template <typename T, typename Write> void with_element_text(const T &element, Write &&write) {
+    if constexpr (std::is_same_v<T, char>) {
+        write(std::string_view(&element, 1));
+    } else if constexpr (std::is_same_v<T, bool>) {
+        write(std::string_view(element ? "true" : "false"));
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        char buf[64];
+        auto result = std::to_chars(buf, buf + sizeof(buf), element);
+        write(std::string_view(buf, static_cast<size_t>(result.ptr - buf)));
+    } else {
+        static_assert(std::is_convertible_v<const T &, std::string_view>,
+                      "join elements must be string-like or arithmetic");
+        write(std::string_view(element));
+    }
+}
+
+} // namespace detail
+
+/**
+ * @class JoinView
+ * @brief A lazy join of a range with a separator, written piece by piece without building the result.
+ *
+ * Elements may be anything convertible to std::string_view, chars, or arithmetic values (formatted with
+ * std::to_chars, i.e. shortest round-trip form for floating point). The range must outlive the view and be
+ * traversable more than once if both size() and write_to() are used.
+ */
+template <typename Range> class JoinView {
+  public:
+    JoinView(const Range &elements, std::string_view separator) : elements_(&elements), separator_(separator) {}
+    JoinView(const Range &&elements, std::string_view separator) = delete; // the view would outlive a temporary
+
+    /// Call @p sink with every piece of the joined text, in order, as a std::string_view.
+    template <typename Sink> void write_to(Sink &&sink) const {
+        bool first = true;
+        for (const auto &element : *elements_) {
+            if (!first)
+                sink(separator_);
+            first = false;
+            detail::with_element_text(element, sink);
+        }
+    }
+
+    /// Exact length of the joined text.
+    size_t size() const {
+        size_t total = 0;
+        write_to([&](std::string_view piece) { total += piece.size(); });
+        return total;
+    }
+
+    /// Materialise the joined text with a single allocation.
+    std::string str() const {
+        std::string out;
+        out.reserve(size());
+        write_to([&](std::string_view piece) { out += piece; });
+        return out;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const JoinView &view) {
+        view.write_to([&](std::string_view piece) { os << piece; });
+        return os;
+    }
+
+  private:
+    const Range *elements_;
+    std::string_view separator_;
+};
+
+/**
+ * @brief Lazily join elements with a separator.
+ * @param elements Range of string-like or arithmetic elements; must outlive the view.
+ * @param separator Separator string; must outlive the view.
+ * @return JoinView over the elements.
+ */
+template <typename Range> JoinView<Range> join_view(const Range &elements, std::string_view separator) {
+    return JoinView<Range>(elements, separator);
+}
+
+/// A view over a temporary range would dangle; join() it instead.
+template <typename Range> void join_view(const Range &&elements, std::string_view separator) = delete;
+
+/**
+ * @brief Join any range of string-like or arithmetic elements with a separator.
+ *
+ * The exact output length is computed first, so the result is allocated once and filled in a single pass.
+ *
+ * @param elements Range of elements (e.g. std::string_view, const char *, int, double).
+ * @param separator Separator string.
+ * @return Concatenated string.
+ */
+template <typename Range> std::string join(const Range &elements, std::string_view separator) {
+    return join_view(elements, separator).str();
+}
 
 /// Trim whitespace from both ends of a string.
-std::string trim(const std::string &s);
+std::string trim(std::string_view s);
+
+/// Like trim, but returns a view into @p s instead of a copy.
+std::string_view trim_view(std::string_view s);
 
 /**
  * @brief Surround a string with left and right substrings.
@@ -265,21 +694,21 @@ std::string trim(const std::string &s);
  * @param right Right surround string (default empty).
  * @return Surrounded string.
  */
-std::string surround(const std::string &str, const std::string &left, const std::string &right = "");
+std::string surround(std::string_view str, std::string_view left, std::string_view right = "");
 
 /**
  * @brief Convert a PascalCase string to snake_case.
  * @param input Input PascalCase string.
  * @return Converted string.
  */
-std::string pascal_to_snake_case(const std::string &input);
+std::string pascal_to_snake_case(std::string_view input);
 
 /**
  * @brief Convert a snake_case string to PascalCase.
  * @param input Input snake_case string.
  * @return Converted string.
  */
-std::string snake_to_pascal_case(const std::string &input);
+std::string snake_to_pascal_case(std::string_view input);
 
 /**
  * @brief Join a string with newlines removed or replaced.
@@ -287,34 +716,84 @@ std::string snake_to_pascal_case(const std::string &input);
  * @param replace_newlines_with_space Whether to replace newlines with spaces.
  * @return Joined string.
  */
-std::string join_multiline(const std::string &input, bool replace_newlines_with_space = false);
+std::string join_multiline(std::string_view input, bool replace_newlines_with_space = false);
 
 /// Replace a character with another in a string.
-std::string replace_char(const std::string &input, char from_char, char to_char);
+std::string replace_char(std::string_view input, char from_char, char to_char);
 
 /// Replace characters in a string according to a mapping.
-std::string replace_chars(const std::string &input, const std::unordered_map<char, char> &mapping);
+std::string replace_chars(std::string_view input, const std::unordered_map<char, char> &mapping);
 
 /// Replace all occurrences of a substring with another substring.
-std::string replace_substring(const std::string &input, const std::string &from_substr, const std::string &to_substr);
+std::string replace_substring(std::string_view input, std::string_view from_substr, std::string_view to_substr);
 
 /// Check if a string starts with a prefix.
-bool starts_with(const std::string &str, const std::string &prefix);
+bool starts_with(std::string_view str, std::string_view prefix);
 
 /// Check if a string contains a substring.
-bool contains(const std::string &str, const std::string &substr);
+bool contains(std::string_view str, std::string_view substr);
 
 /// Extract a substring from start to end indices.
-std::string get_substring(const std::string &input, size_t start, size_t end);
+std::string get_substring(std::string_view input, size_t start, size_t end);
+
+/// Like get_substring, but returns a view into @p input instead of a copy.
+std::string_view get_substring_view(std::string_view input, size_t start, size_t end);
 
 /// Remove all newlines from a string.
-std::string remove_newlines(const std::string &input);
+std::string remove_newlines(std::string_view input);
 
 /// Collapse consecutive whitespace into a single space.
-std::string collapse_whitespace(const std::string &input);
+std::string collapse_whitespace(std::string_view input);
 
 /// Replace literal "\n" sequences with real newlines.
-std::string replace_literal_newlines_with_real(const std::string &input);
+std::string replace_literal_newlines_with_real(std::string_view input);
+
+/// Escaping conventions understood by escape() and unescape().
+enum class EscapeProfile {
+    c,     /**< C string literals: \n \t \r \\ \" \' \a \b \f \v \? \ooo \xNN \uXXXX. */
+    json,  /**< JSON strings: \n \t \r \b \f \\ \" \/ \uXXXX, including surrogate pairs. */
+    shell, /**< POSIX shell words: single quotes, double quotes and backslashes. */
+};
+
+/**
+ * @brief Exact length escape() will produce for @p input.
+ * @param input Raw text.
+ * @param profile Escaping convention.
+ * @return Length of the escaped text.
+ */
+size_t escaped_size(std::string_view input, EscapeProfile profile = EscapeProfile::c);
+
+/**
+ * @brief Escape text so it can be embedded in a C literal, a JSON string or a shell command.
+ *
+ * C and JSON escape quotes, backslashes and control characters; other bytes, including UTF-8 sequences, are copied
+ * unchanged. Shell returns words made only of safe characters as is and single-quotes everything else. The output is
+ * sized exactly up front and runs of bytes that need no escaping are copied in bulk.
+ *
+ * @param input Raw text.
+ * @param profile Escaping convention.
+ * @return Escaped text.
+ */
+std::string escape(std::string_view input, EscapeProfile profile = EscapeProfile::c);
+
+/**
+ * @brief Undo escape(), or decode text escaped by other producers of the same convention.
+ *
+ * \uXXXX escapes are decoded to UTF-8. Unknown or truncated escapes, and unpaired surrogates, are kept verbatim.
+ * An octal escape ends before a digit that would take its value past \377.
+ *
+ * @param input Escaped text.
+ * @param profile Escaping convention.
+ * @return Unescaped text.
+ */
+std::string unescape(std::string_view input, EscapeProfile profile = EscapeProfile::c);
+
+/**
+ * @brief Unescape @p text in place; unescaping never makes text longer, so no allocation is needed.
+ * @param text Escaped text, replaced by its unescaped form.
+ * @param profile Escaping convention.
+ */
+void unescape_in_place(std::string &text, EscapeProfile profile = EscapeProfile::c);
 
 /**
  * @brief Indent text by a given number of levels.
@@ -323,7 +802,7 @@ std::string replace_literal_newlines_with_real(const std::string &input);
  * @param spaces_per_indent Number of spaces per level.
  * @return Indented string.
  */
-std::string indent(const std::string &text, int indent_level, int spaces_per_indent = 4);
+std::string indent(std::string_view text, int indent_level, int spaces_per_indent = 4);
 
 /**
  * @brief Create a map from words to their abbreviations.
@@ -332,6 +811,267 @@ std::string indent(const std::string &text, int indent_level, int spaces_per_ind
  */
 std::unordered_map<std::string, std::string> map_words_to_abbreviations(const std::vector<std::string> &words);
 
+/**
+ * @class LineIndex
+ * @brief Random access to the lines of a large text buffer.
+ *
+ * Records the offset of every line start, so line(i) is O(1) and mapping a byte offset to its line is O(log n). The
+ * starts are found by searching for '\n' with memchr rather than by examining each byte in a loop. Lines end at "\n"
+ * or newline_windows ("\r\n"); the terminator is not part of the returned line. As with std::getline, a final newline
+ * does not start an extra empty line.
+ *
+ * The index does not own the text. When the buffer grows, pass the grown buffer to update() and only the new bytes are
+ * scanned.
+ */
+class LineIndex {
+  public:
+    LineIndex() = default;
+
+    /// Index @p text, which must stay valid while the index is used.
+    explicit LineIndex(std::string_view text) { update(text); }
+
+    /**
+     * @brief Re-point the index at @p text, which must start with the previously indexed text.
+     *
+     * Only the bytes past the previously indexed length are scanned.
+     */
+    void update(std::string_view text);
+
+    /// Number of lines.
+    size_t line_count() const;
+
+    /**
+     * @brief The @p index-th line, without its terminator.
+     * @throws std::out_of_range if index is invalid.
+     */
+    std::string_view line(size_t index) const;
+
+    /**
+     * @brief Byte offset at which the @p index-th line starts.
+     * @throws std::out_of_range if index is invalid.
+     */
+    size_t line_start(size_t index) const;
+
+    /**
+     * @brief Index of the line containing byte @p offset (a terminator belongs to the line it ends).
+     * @throws std::out_of_range if offset is past the end of the text.
+     */
+    size_t line_of_offset(size_t offset) const;
+
+  private:
+    std::string_view text_;
+    std::vector<size_t> starts_{0}; /**< Offset just past every '\n', preceded by 0. */
+};
+
+/**
+ * @class StringInterner
+ * @brief Stores each distinct string once and hands out stable handles to it.
+ *
+ * Interned bytes live in an arena of fixed-size chunks that never move, so the returned string_views stay valid for
+ * the lifetime of the interner. Every distinct string also gets an integer Id, so two interned strings compare equal
+ * exactly when their Ids do.
+ *
+ * With Sync::sharded the strings are spread over independently locked shards by hash, so threads interning different
+ * strings rarely contend. With Sync::none there is no locking and Ids are dense: 0, 1, 2, ... in first-intern order.
+ */
+class StringInterner {
+  public:
+    using Id = uint32_t;
+
+    /// Whether the interner may be used from several threads at once.
+    enum class Sync {
+        none,    /**< Single-threaded use only. */
+        sharded, /**< Every member function is thread safe. */
+    };
+
+    /**
+     * @param sync Locking mode.
+     * @param chunk_size Bytes per arena chunk; longer strings get a chunk of their own.
+     */
+    explicit StringInterner(Sync sync = Sync::none, size_t chunk_size = 4096);
+
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    /**
+     * @brief Id of @p s, storing a copy of it if it has not been seen before.
+     * @throws std::length_error if every Id is taken.
+     */
+    Id intern(std::string_view s);
+
+    /// Stable view of the stored copy of @p s, storing one if it has not been seen before.
+    std::string_view intern_view(std::string_view s) { return view(intern(s)); }
+
+    /**
+     * @brief The string that @p id was handed out for.
+     * @throws std::out_of_range if id was not handed out by this interner.
+     */
+    std::string_view view(Id id) const;
+
+    /// True if @p s has been interned.
+    bool contains(std::string_view s) const;
+
+    /// Number of distinct strings interned.
+    size_t size() const;
+
+  private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string_view, uint32_t> index; /**< Views into chunks -> index into strings. */
+        std::vector<std::string_view> strings;
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char *cursor = nullptr; /**< Free space in the chunk being filled. */
+        size_t remaining = 0;
+    };
+
+    size_t shard_of(std::string_view s) const;
+    std::string_view store(Shard &shard, std::string_view s);
+
+    Sync sync_;
+    size_t chunk_size_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+/**
+ * @class TextNormalizer
+ * @brief Applies a chain of whitespace clean-up stages in a single pass over the input.
+ *
+ * Stages are declared in the order they should run and behave exactly like calling the matching free functions one
+ * after another, but every stage is a small state machine fed by the previous one, so the input is read once and
+ * the output written once, without intermediate strings. The text is processed in cache-sized blocks, and within a
+ * block each stage copies the runs of bytes it does not react to in bulk.
+ *
+ * @code
+ * std::string clean = TextNormalizer().join_lines(true).collapse_whitespace().trim().apply(text);
+ * @endcode
+ */
+class TextNormalizer {
+  public:
+    /// Like trim(): strip whitespace from both ends of the text.
+    TextNormalizer &trim();
+
+    /// Strip whitespace (including '\r') from both ends of every line, keeping the line breaks.
+    TextNormalizer &trim_lines();
+
+    /// Like join_multiline(): trim every line and join them, optionally separated by spaces.
+    TextNormalizer &join_lines(bool replace_newlines_with_space = false);
+
+    /// Like collapse_whitespace(): turn every run of whitespace into a single space.
+    TextNormalizer &collapse_whitespace();
+
+    /// Like remove_newlines(): drop every '\n' and '\r'.
+    TextNormalizer &remove_newlines();
+
+    /// Like remove_consecutive_duplicates(): collapse runs of the same character (empty = any character).
+    TextNormalizer &remove_consecutive_duplicates(std::string_view dedup_chars = "");
+
+    /// Keep at most @p max_blank lines in every run of blank (whitespace only) lines.
+    TextNormalizer &cap_blank_lines(size_t max_blank);
+
+    /// Run all stages over @p input.
+    std::string apply(std::string_view input) const;
+
+  private:
+    enum class StageKind {
+        trim,
+        trim_lines,
+        join_lines,
+        collapse_whitespace,
+        remove_newlines,
+        remove_consecutive_duplicates,
+        cap_blank_lines,
+    };
+
+    struct Stage {
+        StageKind kind;
+        bool replace_newlines_with_space = false;
+        size_t max_blank = 0;
+        std::array<bool, 256> dedup{}; /**< Characters to deduplicate. */
+    };
+
+    struct NormalizerState;
+
+    /// Run one stage over a block of its input, appending to @p out and carrying state across blocks.
+    static void run_stage(const Stage &stage, NormalizerState &st, std::string_view in, std::string &out);
+
+    TextNormalizer &add_stage(Stage stage) {
+        stages_.push_back(stage);
+        return *this;
+    }
+
+    std::vector<Stage> stages_;
+};
+
+/**
+ * @class Tokenizer
+ * @brief Splits text into delimiter and text tokens without copying.
+ *
+ * A Tokenizer is configured once with a set of single-character delimiters and a set of whitespace characters.
+ * Tokens are views into the scanned input: every delimiter character is a token of its own, and the run of
+ * characters between two delimiters is a text token with surrounding whitespace trimmed off. Character classes are
+ * looked up in a 256 entry table, so scanning costs one load per byte regardless of the size of the sets. With up to
+ * six delimiters, find_delimiter() compares 16 bytes at a time against each of them instead (SSE2 on x86-64, NEON on
+ * AArch64); larger sets, and other targets, use the table.
+ */
+class Tokenizer {
+  public:
+    enum class TokenKind {
+        text,      /**< Run of non-delimiter characters, trimmed (may be empty). */
+        delimiter, /**< A single delimiter character. */
+        end,       /**< The input is exhausted. */
+    };
+
+    struct Token {
+        TokenKind kind;
+        std::string_view text; /**< View into the scanned input. */
+    };
+
+    /**
+     * @param delimiters Characters that end a text token and form tokens of their own.
+     * @param whitespace Characters trimmed from both ends of text tokens.
+     */
+    explicit Tokenizer(std::string_view delimiters, std::string_view whitespace = " \t\n\r");
+
+    bool is_delimiter(char c) const { return classes_[static_cast<unsigned char>(c)] & DELIMITER; }
+    bool is_whitespace(char c) const { return classes_[static_cast<unsigned char>(c)] & WHITESPACE; }
+
+    /// Position of the first delimiter at or after @p pos, or std::string_view::npos (also when @p pos is past the end).
+    size_t find_delimiter(std::string_view input, size_t pos = 0) const;
+
+    /**
+     * @brief Scan the text token starting at @p pos.
+     * @param input The input string.
+     * @param pos The current position (will be updated to the delimiter ending the token, or the end of input).
+     * @return std::string_view The token with whitespace trimmed; empty if @p pos is at a delimiter.
+     */
+    std::string_view scan_text(std::string_view input, size_t &pos) const;
+
+    /**
+     * @brief Read the next token.
+     * @param input The input string.
+     * @param pos The current position (will be updated to just after the token).
+     */
+    Token next(std::string_view input, size_t &pos) const;
+
+    /// Tokenize all of @p input; the final end token is not included.
+    std::vector<Token> tokenize(std::string_view input) const;
+
+    /// Split @p input at every delimiter, keeping empty and untrimmed pieces.
+    std::vector<std::string_view> split(std::string_view input) const;
+
+  private:
+    static constexpr unsigned char DELIMITER = 1;
+    static constexpr unsigned char WHITESPACE = 2;
+    static constexpr size_t MAX_VECTOR_DELIMITERS = 6;
+
+    std::array<unsigned char, 256> classes_{};
+    std::array<char, MAX_VECTOR_DELIMITERS> vector_delimiters_{}; /**< Distinct delimiters, for the vector scan. */
+    size_t vector_delimiter_count_ = 0; /**< Number of distinct delimiters; larger sets only use the table. */
+};
+
 // startfold formatting {"attr"= value, ... }
 
 /**
@@ -357,7 +1097,80 @@ struct Node {
  * @param pos The current parsing position (will be updated to the end of the block).
  * @return Node The parsed block node.
  */
-Node parse_block(const std::string &s, size_t &pos);
+Node parse_block(std::string_view s, size_t &pos);
+
+/**
+ * @struct InternedNode
+ * @brief A Node whose key and value are Ids in a StringInterner.
+ *
+ * A node holds two 4 byte Ids instead of two std::string objects, and each distinct key or value is stored once in
+ * the interner, so a large document with repeated keys takes a fraction of the memory of its Node tree.
+ *
+ * Only parse_block sets the Ids, interning "" for a missing key or value. The Ids of a default constructed node are
+ * placeholders and do not name any particular string; Id 0 is whatever the interner stored first.
+ */
+struct InternedNode {
+    StringInterner::Id key = 0;         /**< Id of the key (of "" if not applicable), set by parse_block. */
+    StringInterner::Id value = 0;       /**< Id of the value (of "" if block), set by parse_block. */
+    std::vector<InternedNode> children; /**< Child nodes if this node is a block. */
+    bool is_block = false;              /**< True if this node represents a block. */
+    char block_type = '{';              /**< Type of block: '{' for {}, '(' for (). */
+};
+
+/**
+ * @brief Parses a block like parse_block, storing keys and values in @p strings.
+ *
+ * @param s The input string containing nested blocks.
+ * @param pos The current parsing position (will be updated to the end of the block).
+ * @param strings Interner the keys and values are stored in; it must outlive any use of the Ids.
+ * @return InternedNode The parsed block node.
+ */
+InternedNode parse_block(std::string_view s, size_t &pos, StringInterner &strings);
+
+/// The Node tree with the same text as @p node, whose Ids are in @p strings.
+Node to_node(const InternedNode &node, const StringInterner &strings);
+
+/**
+ * @brief Parses a block like parse_block, splitting the work for large inputs across threads.
+ *
+ * A pre-scan over the structural characters finds the boundaries of the block's top-level children; contiguous
+ * runs of children are then parsed on separate threads and stitched together in their original order. The result is
+ * identical to parse_block. Small, malformed or unterminated inputs are parsed sequentially.
+ *
+ * @param s The input string containing nested blocks.
+ * @param pos The current parsing position (will be updated to the end of the block).
+ * @param thread_count Maximum number of threads to use (0 = hardware concurrency).
+ * @param min_chunk_size Minimum number of bytes handed to one thread.
+ * @return Node The parsed block node.
+ */
+Node parse_block_parallel(std::string_view s, size_t &pos, size_t thread_count = 0, size_t min_chunk_size = 1 << 16);
+
+/**
+ * @struct BoxOptions
+ * @brief Spacing and elision settings for box rendering.
+ *
+ * The defaults give the plain rendering. Text cut short by max_text_width, and subtrees or children left out by
+ * max_depth and max_children, are marked with "...".
+ */
+struct BoxOptions {
+    size_t min_inner = 8;                      /**< Minimum inner width of a box. */
+    size_t h_pad = 3;                          /**< Columns between a box's border and its contents. */
+    size_t v_pad = 1;                          /**< Blank rows around each child. */
+    size_t max_depth = std::string::npos;      /**< Blocks nested deeper than this are shown as one line. */
+    size_t max_children = std::string::npos;   /**< Children of a box past this count are folded into one line. */
+    size_t max_text_width = std::string::npos; /**< Longer titles and entries are shortened to this width. */
+};
+
+/**
+ * @struct BoxViewport
+ * @brief The rectangle of a box rendering that is actually produced, in rows and columns.
+ */
+struct BoxViewport {
+    size_t row = 0;
+    size_t column = 0;
+    size_t height = std::string::npos;
+    size_t width = std::string::npos;
+};
 
 /**
  * @brief Formats a nested braces string into a visual ASCII box.
@@ -365,9 +1178,11 @@ Node parse_block(const std::string &s, size_t &pos);
  * Combines parsing and formatting into a single step.
  *
  * @param input The input string containing nested blocks.
+ * @param options Spacing and elision settings.
  * @return std::string The formatted ASCII box representation.
  */
-std::string format_nested_braces_string_recursive_as_boxes(const std::string &input);
+std::string format_nested_braces_string_recursive_as_boxes(std::string_view input,
+                                                           const BoxOptions &options = BoxOptions());
 
 /**
  * @brief Convenience function to format a nested braces string with newlines and indentation.
@@ -380,7 +1195,265 @@ std::string format_nested_braces_string_recursive_as_boxes(const std::string &in
  * @todo doesn't deal with unordered maps very well
  *
  */
-std::string format_nested_braces_string_recursive_with_newlines(const std::string &input);
+std::string format_nested_braces_string_recursive_with_newlines(std::string_view input);
+
+/**
+ * @class BoxLineGenerator
+ * @brief Produces the rows of a Node tree's box rendering one at a time.
+ *
+ * Box sizes are measured once up front; each row is then drawn on demand by descending through the boxes that
+ * cross it, so only the row being produced is ever materialised. The rows are identical to those of
+ * format_nested_braces_string_recursive_as_boxes (without the trailing newlines).
+ *
+ * With a viewport set, only the rows and columns inside it are produced, and boxes entirely outside it are skipped
+ * without being drawn, so scrolling costs time proportional to the visible cells rather than to the tree.
+ */
+class BoxLineGenerator {
+  public:
+    /// Render @p root, which must outlive the generator.
+    explicit BoxLineGenerator(const Node &root, const BoxOptions &options = BoxOptions());
+
+    /// Render @p root, taking ownership of it.
+    explicit BoxLineGenerator(Node &&root, const BoxOptions &options = BoxOptions());
+
+    /**
+     * @brief Restrict the output to @p viewport and restart from its first row.
+     *
+     * The layout is not recomputed, so this is cheap enough to call on every scroll.
+     */
+    void set_viewport(const BoxViewport &viewport);
+
+    /**
+     * @brief Produce the next row.
+     * @param line Receives the row (overwritten).
+     * @return false once every row has been produced.
+     */
+    bool next(std::string &line);
+
+    /// Width of the whole rendering, ignoring the viewport.
+    size_t width() const;
+
+    /// Number of rows of the whole rendering, ignoring the viewport.
+    size_t height() const;
+
+  private:
+    friend class BoxRenderCache;
+
+    using Box = std::shared_ptr<const std::vector<std::string>>;
+    using RenderChild = std::function<Box(const Node &child, size_t depth)>;
+
+    struct Layout {
+        size_t width = 0;
+        size_t height = 0;
+        size_t shown = 0;            /**< Children drawn; any others share one "..." line after them. */
+        std::vector<size_t> child_y; /**< First row of each shown child, then of the "..." line if any. */
+    };
+
+    struct Cursor;
+
+    /// Lay out @p root as a subtree at @p depth, copying the boxes of its expanded children from @p render_child.
+    BoxLineGenerator(const Node &root, const BoxOptions &options, size_t depth, const RenderChild &render_child);
+
+    bool expanded(const Node &child, size_t depth) const;
+    std::string shorten(std::string text) const;
+    std::string entry_text(const Node &child) const;
+    void measure(const Node &node, size_t depth, const RenderChild &render_child);
+    void write_row(const Node &node, size_t row, size_t depth, Cursor &cursor) const;
+
+    std::shared_ptr<const Node> owned_;
+    const Node *root_;
+    BoxOptions options_;
+    size_t depth_ = 0;
+    std::unordered_map<const Node *, Layout> layouts_;
+    std::unordered_map<const Node *, Box> boxes_; /**< Children drawn from ready-made boxes instead of layouts_. */
+    BoxViewport viewport_;
+    size_t row_ = 0;
+};
+
+/**
+ * @class NewlineLineGenerator
+ * @brief Produces the lines of format_nested_braces_string_recursive_with_newlines one at a time.
+ *
+ * The tree is walked with an explicit stack, so memory use is proportional to the tree depth rather than to the
+ * size of the output.
+ */
+class NewlineLineGenerator {
+  public:
+    /// Format @p root, which must outlive the generator.
+    explicit NewlineLineGenerator(const Node &root);
+
+    /// Format @p root, taking ownership of it.
+    explicit NewlineLineGenerator(Node &&root);
+
+    /**
+     * @brief Produce the next line.
+     * @param line Receives the line (overwritten).
+     * @return false once every line has been produced.
+     */
+    bool next(std::string &line);
+
+  private:
+    struct Frame {
+        const Node *node;
+        int indent;
+        bool last_in_parent; /**< False if a comma follows this node's final line. */
+        bool opened = false;
+        size_t next_child = 0;
+    };
+
+    std::shared_ptr<const Node> owned_;
+    std::vector<Frame> stack_;
+};
+
+/**
+ * @class BoxRenderCache
+ * @brief Renders Node trees as ASCII boxes, reusing boxes of subtrees that did not change between renders.
+ *
+ * Every block subtree is fingerprinted from its key, value, block type and children. Rendered boxes are kept in a
+ * bounded LRU cache keyed by that fingerprint, so re-rendering a new version of a mostly unchanged tree only lays out
+ * the blocks on the path to the nodes that actually changed; everything else is blitted from the cache.
+ *
+ * Boxes are laid out by BoxLineGenerator, so the output is identical to
+ * format_nested_braces_string_recursive_as_boxes with the same options.
+ */
+class BoxRenderCache {
+  public:
+    /**
+     * @param capacity Maximum number of rendered subtree boxes kept (0 disables caching).
+     * @param options Spacing and elision settings of every rendering.
+     */
+    explicit BoxRenderCache(size_t capacity = 1024, const BoxOptions &options = BoxOptions())
+        : options_(options), capacity_(capacity) {}
+
+    /// Parse a nested braces string and render it as boxes.
+    std::string render(std::string_view input);
+
+    /// Render an already parsed Node tree as boxes.
+    std::string render(const Node &root);
+
+    /// Render an already parsed Node tree as boxes, one string per output row.
+    std::vector<std::string> render_lines(const Node &root);
+
+    /// Number of subtree lookups answered from the cache.
+    size_t hits() const { return hits_; }
+
+    /// Number of subtree lookups that required a fresh layout.
+    size_t misses() const { return misses_; }
+
+    /// Number of subtree boxes currently cached.
+    size_t size() const { return lru_.size(); }
+
+    /// Maximum number of subtree boxes kept.
+    size_t capacity() const { return capacity_; }
+
+    /// Settings the boxes are rendered with.
+    const BoxOptions &options() const { return options_; }
+
+    /// Reset the hit and miss counters.
+    void reset_stats() { hits_ = misses_ = 0; }
+
+    /// Drop all cached boxes.
+    void clear() {
+        lru_.clear();
+        index_.clear();
+    }
+
+  private:
+    /// Two independent 64 bit hashes of a subtree; together they make accidental collisions negligible.
+    struct Fingerprint {
+        uint64_t a = 0;
+        uint64_t b = 0;
+        size_t depth = 0; /**< Depth the box was laid out at; only tells boxes apart when max_depth is set. */
+        bool operator==(const Fingerprint &other) const {
+            return a == other.a && b == other.b && depth == other.depth;
+        }
+    };
+
+    struct FingerprintHash {
+        size_t operator()(const Fingerprint &f) const {
+            return static_cast<size_t>(f.a ^ ((f.b + f.depth) * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    using Box = BoxLineGenerator::Box;
+    using Fingerprints = std::unordered_map<const Node *, Fingerprint>;
+
+    struct Entry {
+        Fingerprint fingerprint;
+        Box box;
+    };
+
+    static Fingerprint fingerprint(const Node &node, Fingerprints &out);
+    Box render_node(const Node &node, size_t depth, const Fingerprints &fingerprints);
+
+    BoxOptions options_;
+    size_t capacity_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> lru_; // most recently used at the front
+    std::unordered_map<Fingerprint, std::list<Entry>::iterator, FingerprintHash> index_;
+};
+
+/**
+ * @class NodePathIndex
+ * @brief Maps key paths such as "renderer.camera.fov" to the nodes of a parsed tree.
+ *
+ * The index is built once per tree. Each path segment is a child's key, or its position among its siblings for
+ * children without a key (e.g. "lights.0.color"). Segments may be separated by '.' or '/', and the empty path names
+ * the root. Every node has exactly one path:
+ *  - Inside a key, '.', '/', '*' and '\\' are escaped with a backslash, and a key made only of digits gets a leading
+ *    backslash so it cannot be mistaken for a position (see escape_segment()).
+ *  - If siblings share a key, the first one is reached through the key and the later ones through their positions.
+ */
+class NodePathIndex {
+  public:
+    using Match = std::pair<std::string, const Node *>; /**< Canonical ('.' separated) path and node. */
+
+    /// Index every node below @p root, which must outlive the index.
+    explicit NodePathIndex(const Node &root);
+    NodePathIndex(const Node &&root) = delete; // the index would point into a temporary tree
+
+    NodePathIndex(const NodePathIndex &other);
+    NodePathIndex &operator=(const NodePathIndex &other);
+    NodePathIndex(NodePathIndex &&) = default;
+    NodePathIndex &operator=(NodePathIndex &&) = default;
+
+    /// The node at @p path, or nullptr. Does not allocate unless @p path uses '/' separators.
+    const Node *find(std::string_view path) const;
+
+    /// Every node at or below @p prefix, in lexicographic path order.
+    std::vector<Match> with_prefix(std::string_view prefix) const;
+
+    /**
+     * @brief Every node whose path matches @p pattern, in document order.
+     *
+     * "*" matches exactly one segment and "**" any number of segments (including none); other segments must match
+     * exactly, e.g. "entities.*.position" or "**.fov".
+     */
+    std::vector<Match> match(std::string_view pattern) const;
+
+    /// Number of indexed nodes, including the root.
+    size_t size() const { return sorted_.size(); }
+
+    /// Path segment naming a child with key @p key, e.g. "a.b" becomes "a\\.b" and "0" becomes "\\0".
+    static std::string escape_segment(std::string_view key);
+
+  private:
+    void build(const Node &node, std::string &path);
+    void index_paths();
+    void match_from(const Node &node, std::string &path, const std::vector<std::string> &segments, size_t next,
+                    std::vector<Match> &out) const;
+
+    static std::vector<std::string> split_path(std::string_view path);
+    static std::string canonical(std::string_view path);
+    static std::vector<std::string> child_segments(const Node &parent);
+
+    const Node *root_;
+    std::vector<Match> sorted_;
+    std::unordered_map<const Node *, size_t> position_; /**< Pre-order position of every node, for match(). */
+    /// Views into the paths in sorted_, which is never modified after construction (moving it keeps them valid).
+    std::unordered_map<std::string_view, const Node *> by_path_;
+};
 
 // endfold
 